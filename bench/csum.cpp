@@ -0,0 +1,79 @@
+#include "jay/util/csum.h"
+#include <catch2/benchmark/catch_benchmark.hpp>
+#include <catch2/catch_test_macros.hpp>
+#include <cstring>
+#include <numeric>
+#include <string>
+#include <vector>
+
+using jay::CsumImpl;
+
+namespace {
+/// Baseline: the previous `std::accumulate` over 16-bit words.
+uint16_t accumulate_csum(std::span<const uint8_t> data) {
+  std::span<const uint16_t> words{
+      reinterpret_cast<const uint16_t *>(data.data()), data.size() / 2};
+  uint64_t sum = std::accumulate(
+      words.begin(), words.end(), uint64_t(0),
+      [](uint64_t acc, uint16_t word) { return acc + uint64_t(word); });
+  return ~jay::csum_fold(sum);
+}
+
+const char *impl_name(CsumImpl impl) {
+  switch (impl) {
+  case CsumImpl::SCALAR:
+    return "scalar";
+  case CsumImpl::SSE2:
+    return "sse2";
+  case CsumImpl::AVX2:
+    return "avx2";
+  case CsumImpl::AVX512:
+    return "avx512";
+  }
+  return "?";
+}
+} // namespace
+
+TEST_CASE("Internet checksum kernels", "[csum][!benchmark]") {
+  std::vector<uint8_t> data(65536);
+  for (size_t i = 0; i < data.size(); i++)
+    data[i] = (i * 31 + 7) % 256;
+  WARN("selected kernel: " << impl_name(jay::csum_selected()));
+
+  for (size_t len : {20, 64, 1500, 65536}) {
+    std::span<const uint8_t> span(data.data(), len);
+    std::string suffix = " " + std::to_string(len) + "B";
+
+    BENCHMARK("accumulate" + suffix) { return accumulate_csum(span); };
+    BENCHMARK("csum_partial" + suffix) {
+      return jay::csum_fold(jay::csum_partial(span));
+    };
+    for (auto impl : {CsumImpl::SCALAR, CsumImpl::SSE2, CsumImpl::AVX2,
+                      CsumImpl::AVX512}) {
+      if (!jay::csum_supported(impl))
+        continue;
+      BENCHMARK(impl_name(impl) + suffix) {
+        return jay::csum_fold(jay::csum_partial(span, 0, impl));
+      };
+    }
+  }
+}
+
+TEST_CASE("Copy with checksum", "[csum][!benchmark]") {
+  std::vector<uint8_t> data(65536), copy(65536);
+  for (size_t i = 0; i < data.size(); i++)
+    data[i] = (i * 31 + 7) % 256;
+
+  for (size_t len : {64, 512, 1500, 65536}) {
+    std::span<const uint8_t> span(data.data(), len);
+    std::string suffix = " " + std::to_string(len) + "B";
+
+    BENCHMARK("memcpy + csum_partial" + suffix) {
+      std::memcpy(copy.data(), span.data(), len);
+      return jay::csum_fold(jay::csum_partial({copy.data(), len}));
+    };
+    BENCHMARK("csum_copy" + suffix) {
+      return jay::csum_fold(jay::csum_copy(span, copy.data()));
+    };
+  }
+}
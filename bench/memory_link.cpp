@@ -0,0 +1,56 @@
+#include "jay/memory_link.h"
+#include "jay/stack.h"
+#include <catch2/benchmark/catch_benchmark.hpp>
+#include <catch2/catch_test_macros.hpp>
+#include <vector>
+
+namespace {
+const jay::ip::IPv4Addr NET_IADDR{10, 0, 0, 0};
+const jay::ip::IPv4Addr CLIENT_IADDR{10, 0, 0, 1};
+const jay::ip::IPv4Addr SERVER_IADDR{10, 0, 0, 2};
+
+void setup(jay::Stack &stack, const std::shared_ptr<jay::MemoryPort> &port,
+           jay::ip::IPv4Addr iaddr) {
+  stack.add_interface(port);
+  stack.ip.assign_ip(port.get(), iaddr, 24);
+  stack.ip.router().add_route(NET_IADDR, 24, port.get(), std::nullopt, iaddr);
+}
+} // namespace
+
+TEST_CASE("UDP echo between two stacks over a memory link",
+          "[memory_link][!benchmark]") {
+  jay::MemoryLink link({0x02, 0, 0, 0, 0, 1}, {0x02, 0, 0, 0, 0, 2});
+  jay::Stack client, server;
+  setup(client, link.a(), CLIENT_IADDR);
+  setup(server, link.b(), SERVER_IADDR);
+
+  auto echo_sock = server.ip.udp_sock();
+  echo_sock.listen(std::nullopt, 7);
+  echo_sock.on_data_fn = [](jay::udp::UDPSocket &sock, const jay::Buf &buf,
+                            jay::ip::IPAddr addr, uint16_t port) {
+    sock.send(buf, addr, port);
+  };
+  size_t replies = 0;
+  auto client_sock = client.ip.udp_sock();
+  client_sock.listen(std::nullopt, 1000);
+  client_sock.on_data_fn = [&](jay::udp::UDPSocket &, const jay::Buf &,
+                               jay::ip::IPAddr, uint16_t) { replies++; };
+
+  auto round_trip = [&](size_t payload_size, size_t count) {
+    jay::Buf payload(payload_size);
+    size_t expected = replies + count;
+    for (size_t i = 0; i < count; i++)
+      client_sock.send(payload, SERVER_IADDR, 7);
+    while (replies < expected) {
+      client.poll();
+      server.poll();
+    }
+    return replies;
+  };
+  // resolve the neighbours outside of the measurement, as only a few packets
+  // are queued while resolving
+  round_trip(64, 1);
+
+  BENCHMARK("32 x 64 B") { return round_trip(64, 32); };
+  BENCHMARK("32 x 1400 B") { return round_trip(1400, 32); };
+}
@@ -0,0 +1,94 @@
+#include "jay/pbuf.h"
+#include <catch2/benchmark/catch_benchmark.hpp>
+#include <catch2/catch_test_macros.hpp>
+#include <numeric>
+#include <random>
+#include <variant>
+
+using jay::PBufStruct;
+
+namespace {
+constexpr size_t PACKET_COUNT = 1 << 16;
+
+struct LegacyNoHdr : public std::monostate,
+                     public jay::BufStruct<LegacyNoHdr> {
+  LegacyNoHdr() : jay::BufStruct<LegacyNoHdr>(jay::StructWriter({})) {}
+};
+
+/// The previous [PBufStruct] layout, holding the parsed header objects in
+/// variants, kept as a baseline for the benchmarks.
+struct LegacyPBufStruct : public jay::Buf {
+  using Buf::Buf;
+  size_t headroom = PBufStruct::HEADROOM;
+
+  jay::Interface *iface = nullptr;
+  std::optional<jay::ip::IPAddr> nh_iaddr;
+  std::optional<jay::HWAddr> nh_haddr;
+
+  bool local = false;
+  bool forwarded = false;
+  bool router_alert = false;
+  bool force_source_ip = true;
+
+  bool has_last_fragment = false;
+
+  std::variant<LegacyNoHdr, jay::EthHeader> link_hdr;
+  std::variant<LegacyNoHdr, jay::ip::ARPHeader, jay::ip::IPHeader> net_hdr;
+  std::variant<LegacyNoHdr, jay::ip::ICMPHeader, jay::udp::UDPHeader,
+               jay::ip::IGMPHeader>
+      tspt_hdr;
+
+  bool is_udp() const {
+    return std::holds_alternative<jay::udp::UDPHeader>(tspt_hdr);
+  }
+};
+
+/// Visit the packets in a random order, as a stack serving many flows would,
+/// inspecting only their metadata.
+template <typename TPacket>
+size_t count_local_udp(const std::vector<TPacket> &packets,
+                       const std::vector<size_t> &order) {
+  size_t count = 0;
+  for (size_t idx : order) {
+    const TPacket &packet = packets[idx];
+    if (packet.is_udp() && packet.local && !packet.forwarded &&
+        !packet.nh_haddr.has_value())
+      count++;
+  }
+  return count;
+}
+
+std::vector<size_t> shuffled_order() {
+  std::vector<size_t> order(PACKET_COUNT);
+  std::iota(order.begin(), order.end(), 0);
+  std::shuffle(order.begin(), order.end(), std::mt19937(1234));
+  return order;
+}
+} // namespace
+
+TEST_CASE("PBuf metadata footprint", "[pbuf][!benchmark]") {
+  size_t legacy_meta = sizeof(LegacyPBufStruct) - sizeof(jay::Buf);
+  size_t meta = sizeof(PBufStruct) - sizeof(jay::Buf);
+  WARN("legacy packet: " << sizeof(LegacyPBufStruct) << " B, metadata "
+                         << legacy_meta << " B (" << (legacy_meta + 63) / 64
+                         << " cache lines)");
+  WARN("packet: " << sizeof(PBufStruct) << " B, metadata " << meta << " B ("
+                  << (meta + 63) / 64 << " cache lines)");
+  REQUIRE(meta <= 64);
+
+  std::vector<size_t> order = shuffled_order();
+  std::vector<LegacyPBufStruct> legacy(PACKET_COUNT);
+  std::vector<PBufStruct> packets(PACKET_COUNT);
+  for (size_t i = 0; i < PACKET_COUNT; i += 2) {
+    legacy[i].local = true;
+    legacy[i].tspt_hdr = jay::udp::UDPHeader();
+    packets[i].local = true;
+    packets[i].construct_tspt_hdr<jay::udp::UDPHeader>();
+  }
+  REQUIRE(count_local_udp(legacy, order) == count_local_udp(packets, order));
+
+  BENCHMARK("legacy metadata scan") { return count_local_udp(legacy, order); };
+  BENCHMARK("compact metadata scan") {
+    return count_local_udp(packets, order);
+  };
+}
@@ -0,0 +1,110 @@
+#include "jay/buf/sbuf.h"
+#include "jay/util/smallvec.h"
+#include "legacy_smallvec.h"
+#include <catch2/benchmark/catch_benchmark.hpp>
+#include <catch2/catch_test_macros.hpp>
+
+using jay::BufChunk;
+using jay::SmallVec;
+using jay::bench::LegacySmallVec;
+
+namespace {
+constexpr size_t INLINE_COUNT = 4;
+constexpr size_t CHAIN_LENGTH = 32;
+
+/// Build a chain of `n` chunks sharing a single backing buffer, as produced by
+/// slicing a received packet.
+template <typename Vec> Vec build_chain(const BufChunk &backing, size_t n) {
+  Vec vec;
+  for (size_t i = 0; i < n; i++)
+    vec.emplace_back(backing.slice(i, 1));
+  return vec;
+}
+
+/// Insert `n` chunks at the front of the chain, shifting all the previous
+/// ones.
+template <typename Vec> Vec build_chain_front(const BufChunk &backing, size_t n) {
+  Vec vec;
+  for (size_t i = 0; i < n; i++)
+    vec.emplace(vec.begin(), backing.slice(i, 1));
+  return vec;
+}
+
+template <typename Vec> size_t sum_sizes(const Vec &vec) {
+  size_t sum = 0;
+  for (const BufChunk &chunk : vec)
+    sum += chunk.size();
+  return sum;
+}
+
+/// Erase every other chunk of the chain.
+template <typename Vec> size_t erase_alternate(Vec &vec) {
+  auto it = vec.begin();
+  while (it != vec.end()) {
+    it = vec.erase(it);
+    if (it != vec.end())
+      it++;
+  }
+  return vec.size();
+}
+} // namespace
+
+TEST_CASE("SmallVec<BufChunk> chain building", "[smallvec][!benchmark]") {
+  BufChunk backing(CHAIN_LENGTH);
+
+  BENCHMARK("legacy emplace_back, inline") {
+    return build_chain<LegacySmallVec<BufChunk, INLINE_COUNT>>(backing,
+                                                              INLINE_COUNT);
+  };
+  BENCHMARK("contiguous emplace_back, inline") {
+    return build_chain<SmallVec<BufChunk, INLINE_COUNT>>(backing, INLINE_COUNT);
+  };
+  BENCHMARK("legacy emplace_back, spilled") {
+    return build_chain<LegacySmallVec<BufChunk, INLINE_COUNT>>(backing,
+                                                              CHAIN_LENGTH);
+  };
+  BENCHMARK("contiguous emplace_back, spilled") {
+    return build_chain<SmallVec<BufChunk, INLINE_COUNT>>(backing, CHAIN_LENGTH);
+  };
+  BENCHMARK("legacy emplace at front") {
+    return build_chain_front<LegacySmallVec<BufChunk, INLINE_COUNT>>(
+        backing, CHAIN_LENGTH);
+  };
+  BENCHMARK("contiguous emplace at front") {
+    return build_chain_front<SmallVec<BufChunk, INLINE_COUNT>>(backing,
+                                                               CHAIN_LENGTH);
+  };
+}
+
+TEST_CASE("SmallVec<BufChunk> chain access", "[smallvec][!benchmark]") {
+  BufChunk backing(CHAIN_LENGTH);
+  auto legacy =
+      build_chain<LegacySmallVec<BufChunk, INLINE_COUNT>>(backing, CHAIN_LENGTH);
+  auto contiguous =
+      build_chain<SmallVec<BufChunk, INLINE_COUNT>>(backing, CHAIN_LENGTH);
+
+  BENCHMARK("legacy iteration") { return sum_sizes(legacy); };
+  BENCHMARK("contiguous iteration") { return sum_sizes(contiguous); };
+
+  BENCHMARK_ADVANCED("legacy erase")(Catch::Benchmark::Chronometer meter) {
+    std::vector<LegacySmallVec<BufChunk, INLINE_COUNT>> vecs(meter.runs(),
+                                                             legacy);
+    meter.measure([&](int i) { return erase_alternate(vecs[i]); });
+  };
+  BENCHMARK_ADVANCED("contiguous erase")(Catch::Benchmark::Chronometer meter) {
+    std::vector<SmallVec<BufChunk, INLINE_COUNT>> vecs(meter.runs(),
+                                                       contiguous);
+    meter.measure([&](int i) { return erase_alternate(vecs[i]); });
+  };
+}
+
+TEST_CASE("Buf chunk chains", "[smallvec][!benchmark]") {
+  BufChunk backing(CHAIN_LENGTH);
+
+  BENCHMARK("Buf reassembly from slices") {
+    jay::Buf buf;
+    for (size_t i = CHAIN_LENGTH; i > 0; i--)
+      buf.insert_chunk(backing.slice(i - 1, 1), i - 1);
+    return buf.chunk_count();
+  };
+}
@@ -0,0 +1,106 @@
+#pragma once
+
+#include "jay/if.h"
+#include <memory>
+#include <span>
+#include <string>
+
+namespace jay {
+/// An interface attached to an existing Linux network interface (e.g. one end
+/// of a veth pair) through an `AF_PACKET` socket with memory-mapped rings.
+///
+/// Frames are received through a `TPACKET_V3` ring, in which the kernel fills
+/// whole blocks of frames. The frames are handed to the stack as chunks
+/// pointing into their block, and the block is returned to the kernel once
+/// every chunk referencing it is released. As the kernel fills the blocks
+/// strictly in order, a single block still referenced once the ring wraps
+/// around to it (e.g. by a fragment queued for reassembly, or by data an
+/// application keeps from [udp::UDPSocket::on_data_owned_fn]) stops the
+/// reception altogether until it is released, see [Stats::rx_stalls].
+/// Applications keeping received data for long should copy it out.
+/// Transmitted packets are copied to the frames of the transmission ring,
+/// which is flushed by a single system call per burst.
+///
+/// The host's network stack sees the frames as well, so the interface should
+/// not be configured with the addresses assigned to jay.
+class AfPacketInterface : public Interface {
+public:
+  struct Options {
+    /// size of a receive block, a multiple of the page size
+    unsigned block_size = 1 << 18;
+    /// number of receive blocks
+    unsigned block_count = 64;
+    /// time after which the kernel hands over a block that isn't full yet
+    unsigned block_timeout_ms = 1;
+    /// size of a transmission frame, including the frame header
+    unsigned tx_frame_size = 2048;
+    /// number of transmission frames
+    unsigned tx_frame_count = 512;
+  };
+
+  struct Stats {
+    /// frames received
+    size_t rx_packets = 0;
+    /// polls that found the next block still referenced by received packets,
+    /// during which the kernel can't deliver (and drops) further frames
+    size_t rx_stalls = 0;
+    /// packets handed to the transmission ring
+    size_t tx_packets = 0;
+    /// packets dropped because they didn't fit a frame or the ring was full
+    size_t tx_errors = 0;
+  };
+
+  /// Attach to the interface `if_name`, taking over its MAC address and MTU.
+  /// Throws [std::system_error] if any of the set-up steps fails (e.g. for
+  /// lack of `CAP_NET_RAW`).
+  AfPacketInterface(const std::string &if_name, Options opts);
+  explicit AfPacketInterface(const std::string &if_name)
+      : AfPacketInterface(if_name, Options{}) {}
+  AfPacketInterface(const AfPacketInterface &) = delete;
+  AfPacketInterface &operator=(const AfPacketInterface &) = delete;
+
+  void enqueue(PBuf packet) override;
+  void enqueue_burst(std::span<PBuf> packets) override;
+  size_t poll_rx_burst(Stack &stack, std::span<PBuf> packets) override;
+  void poll_tx(Stack &stack) override;
+
+  HWAddr addr() const noexcept override { return _hwaddr; }
+  uint16_t mtu() const noexcept override { return _mtu; }
+  bool scatter_gather() const noexcept override { return true; }
+  size_t max_segments() const noexcept override { return MAX_SEGMENTS; }
+  /// The kernel reports the frames whose checksums are known to be correct,
+  /// or left partial by a local sender.
+  bool rx_csum_offload() const noexcept override { return true; }
+
+  const Stats &stats() const { return _stats; }
+
+private:
+  static constexpr size_t MAX_SEGMENTS = 16;
+
+  /// The socket and its mapped rings, shared with the received chunks so that
+  /// their blocks can be returned even after the interface is gone.
+  struct Ring;
+
+  /// Copy `packet` to the next transmission frame, returning false if it is
+  /// dropped.
+  bool put_tx(const PBuf &packet);
+  /// Ask the kernel to transmit the filled frames.
+  void flush_tx();
+
+  std::shared_ptr<Ring> ring;
+  HWAddr _hwaddr;
+  uint16_t _mtu;
+  Options opts;
+
+  /// the block being consumed and the position in it
+  unsigned rx_block = 0;
+  BufChunk rx_block_chunk;
+  uint32_t rx_pkts_left = 0;
+  size_t rx_pkt_off = 0;
+
+  unsigned tx_frame = 0;
+  /// whether frames were filled since the last successful flush
+  bool tx_pending = false;
+  Stats _stats;
+};
+} // namespace jay
@@ -0,0 +1,114 @@
+#pragma once
+
+#include "jay/if.h"
+#include <span>
+#include <string>
+#include <vector>
+
+namespace jay {
+/// An interface attached to a queue of a Linux network interface through an
+/// `AF_XDP` socket.
+///
+/// On attaching, a minimal XDP program is loaded on the interface, which
+/// redirects every frame received on the queue to the socket (frames of other
+/// queues go to the host's stack). The frames are received into the UMEM, an
+/// area registered with the socket, and each UMEM frame is handed to the stack
+/// as a chunk of its own. A frame goes straight back to the fill ring once the
+/// last reference to it is dropped. Transmitted packets are copied to frames
+/// reserved for transmission, which are reused once the kernel reports them
+/// completed.
+///
+/// The program is attached in generic (SKB) mode by default, which works on
+/// any interface, including veth pairs, at the cost of a copy in the kernel.
+/// Attaching requires Linux 5.9 and `CAP_NET_ADMIN` together with `CAP_BPF`
+/// (or `CAP_SYS_ADMIN`); the program is detached when the interface is
+/// destroyed.
+class AfXdpInterface : public Interface {
+public:
+  struct Options {
+    /// queue of the interface to attach to
+    uint32_t queue_id = 0;
+    /// UMEM frames used for reception, a power of two
+    uint32_t rx_frames = 2048;
+    /// UMEM frames used for transmission, a power of two
+    uint32_t tx_frames = 1024;
+    /// size of a UMEM frame, a power of two of at least 2048
+    uint32_t frame_size = 2048;
+    /// attach the program in generic mode and copy the frames; native mode
+    /// requires driver support
+    bool generic_mode = true;
+  };
+
+  struct Stats {
+    /// frames received
+    size_t rx_packets = 0;
+    /// packets handed to the transmission ring
+    size_t tx_packets = 0;
+    /// packets dropped because they didn't fit a frame or no frame was free
+    size_t tx_errors = 0;
+  };
+
+  /// Attach to the queue `opts.queue_id` of the interface `if_name`, taking
+  /// over its MAC address and MTU. Throws [std::system_error] if any of the
+  /// set-up steps fails.
+  AfXdpInterface(const std::string &if_name, Options opts);
+  explicit AfXdpInterface(const std::string &if_name)
+      : AfXdpInterface(if_name, Options{}) {}
+  AfXdpInterface(const AfXdpInterface &) = delete;
+  AfXdpInterface &operator=(const AfXdpInterface &) = delete;
+  ~AfXdpInterface() override;
+
+  void enqueue(PBuf packet) override;
+  void enqueue_burst(std::span<PBuf> packets) override;
+  size_t poll_rx_burst(Stack &stack, std::span<PBuf> packets) override;
+  void poll_tx(Stack &stack) override;
+
+  HWAddr addr() const noexcept override { return _hwaddr; }
+  uint16_t mtu() const noexcept override { return _mtu; }
+  bool scatter_gather() const noexcept override { return true; }
+  size_t max_segments() const noexcept override { return MAX_SEGMENTS; }
+
+  const Stats &stats() const { return _stats; }
+
+private:
+  static constexpr size_t MAX_SEGMENTS = 16;
+
+  /// One of the rings shared with the kernel (see the `AF_XDP` documentation).
+  struct XskRing {
+    uint32_t *producer = nullptr;
+    uint32_t *consumer = nullptr;
+    uint32_t *flags = nullptr;
+    void *descs = nullptr;
+    uint32_t mask = 0;
+    /// the local copy of the index advanced by this side
+    uint32_t cached = 0;
+    void *map = nullptr;
+    size_t map_size = 0;
+  };
+
+  class Umem;
+
+  void setup_socket(int ifindex);
+  void setup_program(int ifindex);
+  /// Copy `packet` to a free transmission frame, returning false if it is
+  /// dropped.
+  bool put_tx(const PBuf &packet);
+  /// Publish the filled transmission descriptors and wake the kernel up.
+  void flush_tx();
+  void teardown();
+
+  HWAddr _hwaddr;
+  uint16_t _mtu;
+  Options opts;
+  int xsk_fd = -1;
+  int map_fd = -1;
+  int prog_fd = -1;
+  int link_fd = -1;
+
+  Umem *umem = nullptr;
+  XskRing rx, tx, fill, comp;
+  /// transmission frames not in flight, as UMEM addresses
+  std::vector<uint64_t> free_tx;
+  Stats _stats;
+};
+} // namespace jay
@@ -0,0 +1,111 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <memory_resource>
+#include <vector>
+
+namespace jay {
+/// A [std::pmr::memory_resource] for packet data.
+///
+/// Allocations are served from a small number of size classes (headroom-sized,
+/// MTU-sized and jumbo-sized), whose slots are carved out of large `mmap`-ed
+/// regions. Freed slots are kept on a per-class free list and never returned
+/// to the system before the resource is destroyed, so that under sustained
+/// load the packet data stays within a few (optionally huge) pages. Requests
+/// not fitting into any class are forwarded to the upstream resource.
+///
+/// The resource is not thread-safe and must outlive all the buffers allocated
+/// from it.
+class PacketMemoryResource : public std::pmr::memory_resource {
+public:
+  /// the usable sizes of the slot classes
+  static constexpr std::array<size_t, 3> SIZE_CLASSES = {128, 2048, 9216};
+  /// extra bytes per slot for the bookkeeping allocated together with the data
+  /// (e.g. the inline header of a [BufChunk])
+  static constexpr size_t SLOT_OVERHEAD = 64;
+  /// alignment of all the slots
+  static constexpr size_t SLOT_ALIGN = 64;
+  /// size of a huge page on the supported platforms
+  static constexpr size_t HUGE_PAGE_SIZE = 2 << 20;
+
+  struct Options {
+    /// size of the regions mapped for each size class
+    size_t region_size = HUGE_PAGE_SIZE;
+    /// whether to request the regions to be backed by huge pages
+    /// (`MAP_HUGETLB`, falling back to transparent huge pages)
+    bool huge_pages = false;
+    /// resource used for requests that do not fit into any size class
+    std::pmr::memory_resource *upstream = std::pmr::new_delete_resource();
+  };
+
+  struct Stats {
+    /// number of regions mapped so far
+    size_t regions = 0;
+    /// number of regions backed by `MAP_HUGETLB` pages
+    size_t huge_regions = 0;
+    /// number of allocations forwarded to the upstream resource
+    size_t upstream_allocs = 0;
+    /// bytes currently allocated from the upstream resource
+    size_t upstream_bytes = 0;
+    /// number of slots currently handed out, per size class
+    std::array<size_t, SIZE_CLASSES.size()> in_use{};
+  };
+
+  PacketMemoryResource() : PacketMemoryResource(Options{}) {}
+  explicit PacketMemoryResource(Options opts);
+  PacketMemoryResource(const PacketMemoryResource &) = delete;
+  PacketMemoryResource &operator=(const PacketMemoryResource &) = delete;
+  ~PacketMemoryResource() override;
+
+  const Stats &stats() const { return _stats; }
+  /// Return the number of bytes currently handed out, counting whole slots for
+  /// the size-class allocations.
+  size_t bytes_in_use() const {
+    size_t bytes = _stats.upstream_bytes;
+    for (size_t i = 0; i < SIZE_CLASSES.size(); i++)
+      bytes += _stats.in_use[i] * slot_size(SIZE_CLASSES[i]);
+    return bytes;
+  }
+
+  /// Return the size of the slots of the class serving `bytes`-sized
+  /// requests, or 0 if such requests are forwarded upstream.
+  static constexpr size_t slot_size(size_t bytes) {
+    for (size_t class_size : SIZE_CLASSES) {
+      if (bytes <= class_size + SLOT_OVERHEAD)
+        return align_slot(class_size + SLOT_OVERHEAD);
+    }
+    return 0;
+  }
+
+protected:
+  void *do_allocate(size_t bytes, size_t alignment) override;
+  void do_deallocate(void *p, size_t bytes, size_t alignment) override;
+  bool do_is_equal(const std::pmr::memory_resource &other) const
+      noexcept override {
+    return this == &other;
+  }
+
+private:
+  struct FreeSlot {
+    FreeSlot *next;
+  };
+  struct Region {
+    void *base;
+    size_t size;
+  };
+
+  static constexpr size_t align_slot(size_t size) {
+    return (size + SLOT_ALIGN - 1) & ~(SLOT_ALIGN - 1);
+  }
+  static size_t class_index(size_t bytes);
+
+  void refill(size_t class_idx);
+  void *map_region(size_t size);
+
+  Options opts;
+  std::array<FreeSlot *, SIZE_CLASSES.size()> free_slots{};
+  std::vector<Region> regions;
+  Stats _stats;
+};
+} // namespace jay
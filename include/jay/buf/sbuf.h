@@ -1,55 +1,186 @@
 #pragma once
 
+#include "jay/util/csum.h"
 #include "jay/util/result.h"
 #include "jay/util/smallvec.h"
+#include <algorithm>
+#include <atomic>
 #include <cassert>
+#include <cstring>
 #include <memory>
 #include <memory_resource>
+#include <optional>
 #include <span>
+#include <sys/uio.h>
+#include <utility>
+#include <vector>
+
+#ifndef JAY_THREADSAFE_CHUNKS
+#define JAY_THREADSAFE_CHUNKS 0
+#endif
 
 namespace jay {
+/// Header of a reference-counted buffer shared by [BufChunk] instances.
+///
+/// The reference count is atomic only if the library is built with
+/// `JAY_THREADSAFE_CHUNKS` -- by default, chunks must not be shared between
+/// threads.
+struct ChunkHeader {
+#if JAY_THREADSAFE_CHUNKS
+  using RefCount = std::atomic<size_t>;
+#else
+  using RefCount = size_t;
+#endif
+
+  RefCount refs = 1;
+  /// references not counted by [BufChunk::is_unique]
+  size_t pins = 0;
+  uint8_t *data = nullptr;
+  /// frees the buffer together with the header once the last reference is
+  /// dropped
+  void (*destroy)(ChunkHeader *) = nullptr;
+
+  void acquire() {
+#if JAY_THREADSAFE_CHUNKS
+    refs.fetch_add(1, std::memory_order_relaxed);
+#else
+    refs++;
+#endif
+  }
+
+  void release() {
+#if JAY_THREADSAFE_CHUNKS
+    if (refs.fetch_sub(1, std::memory_order_acq_rel) == 1)
+      destroy(this);
+#else
+    if (--refs == 0)
+      destroy(this);
+#endif
+  }
+
+  size_t use_count() const {
+#if JAY_THREADSAFE_CHUNKS
+    return refs.load(std::memory_order_relaxed);
+#else
+    return refs;
+#endif
+  }
+};
+
 /// A shared owning reference to a part of an in-memory buffer.
 ///
-/// The reference is backed by [std::shared_ptr] together with a per-instance
-/// size and offset. This allows referencing arbitrary slices of buffers of
-/// various origins, potentially allocated using custom allocators and using
-/// user-supplied deleters -- this is useful for zero-copy processing of
-/// user-supplied buffers.
+/// The reference is backed by an intrusively reference-counted [ChunkHeader]
+/// together with a per-instance size and offset. This allows referencing
+/// arbitrary slices of buffers of various origins, potentially allocated using
+/// custom allocators and using user-supplied deleters -- this is useful for
+/// zero-copy processing of user-supplied buffers. Buffers allocated by the
+/// chunk itself store the header directly in front of the data, so that no
+/// separate allocation is needed.
 ///
 /// The chunk may be empty, i.e. not pointing to any buffer, but still have a
 /// nonzero size. Such chunks are used to represent holes in [Buf].
 class BufChunk {
 public:
-  template <class Alloc = std::pmr::polymorphic_allocator<std::byte>>
-  explicit BufChunk(size_t size,
-                    const Alloc &alloc = std::pmr::polymorphic_allocator())
-      : data(std::allocate_shared<uint8_t[], Alloc>(alloc, size)), _size(size) {
-  }
+  explicit BufChunk(
+      size_t size, const std::pmr::polymorphic_allocator<std::byte> &alloc = {})
+      : header(InlineHeader::create(size, alloc.resource())), _size(size) {}
+
+  /// Reference `size` bytes at `offset` of the user-supplied buffer `ptr`,
+  /// calling `deleter(ptr)` once the last reference to it is dropped.
+  template <typename Deleter>
+  BufChunk(uint8_t *ptr, size_t size, size_t offset, Deleter deleter)
+      : header(ExternalHeader<Deleter>::create(ptr, std::move(deleter))),
+        offset(offset), _size(size) {}
 
   explicit BufChunk(std::shared_ptr<uint8_t[]> ptr, size_t size, size_t offset)
-      : data(std::move(ptr)), offset(offset), _size(size) {}
+      : BufChunk(ptr.get(), size, offset, [ptr](uint8_t *) {}) {}
 
-  BufChunk(const BufChunk &) = default;
-  BufChunk &operator=(const BufChunk &) = default;
-  BufChunk(BufChunk &&) = default;
-  BufChunk &operator=(BufChunk &&) = default;
+  /// Take over a reference to `size` bytes at `offset` of the buffer of the
+  /// caller-managed `header`, which must hold the reference being adopted.
+  /// This allows buffers recycled by their owner (e.g. the receive buffers of
+  /// an interface) to be referenced without allocating a header for each use.
+  static BufChunk adopt(ChunkHeader *header, size_t size, size_t offset = 0) {
+    BufChunk chunk;
+    chunk.header = header;
+    chunk.offset = offset;
+    chunk._size = size;
+    return chunk;
+  }
+
+  BufChunk(const BufChunk &other)
+      : header(other.header), offset(other.offset), _size(other._size) {
+    if (header)
+      header->acquire();
+  }
+  BufChunk &operator=(const BufChunk &other) {
+    if (other.header)
+      other.header->acquire();
+    if (header)
+      header->release();
+    header = other.header;
+    offset = other.offset;
+    _size = other._size;
+    return *this;
+  }
+  BufChunk(BufChunk &&other)
+      : header(std::exchange(other.header, nullptr)), offset(other.offset),
+        _size(other._size) {}
+  BufChunk &operator=(BufChunk &&other) {
+    if (this == &other)
+      return *this;
+    if (header)
+      header->release();
+    header = std::exchange(other.header, nullptr);
+    offset = other.offset;
+    _size = other._size;
+    return *this;
+  }
   BufChunk() = default;
+  ~BufChunk() {
+    if (header)
+      header->release();
+  }
 
 public:
   static BufChunk empty(size_t size) {
     BufChunk chunk;
     chunk._size = size;
-    chunk.data = nullptr;
     return chunk;
   }
 
-  uint8_t *begin() { return data.get() + offset; }
-  uint8_t *end() { return data.get() + _size; }
-  const uint8_t *begin() const { return data.get() + offset; }
-  const uint8_t *end() const { return data.get() + _size; }
+  uint8_t *begin() { return data() + offset; }
+  uint8_t *end() { return data() + offset + _size; }
+  const uint8_t *begin() const { return data() + offset; }
+  const uint8_t *end() const { return data() + offset + _size; }
   size_t size() const { return _size; }
 
-  bool is_empty() const { return data == nullptr; }
+  bool is_empty() const { return header == nullptr; }
+
+  /// Whether this instance is the only reference to the underlying buffer,
+  /// not counting a pinned one (see [pin]). Only unique chunks may be written
+  /// to, as the writes would otherwise be visible through the other
+  /// references.
+  bool is_unique() const {
+    return header && (header->use_count() - header->pins <= 1);
+  }
+
+  /// Mark this reference as held by an owner that only keeps the buffer for
+  /// reuse and doesn't access it while other references exist (such as
+  /// [PBufPool]), so that it doesn't count against [is_unique]. The reference
+  /// must be unpinned before being dropped.
+  void pin() {
+    assert(header);
+    header->pins += 1;
+  }
+  void unpin() {
+    assert(header && (header->pins > 0));
+    header->pins -= 1;
+  }
+  /// Whether the buffer is referenced by anything other than pinned
+  /// references.
+  bool has_unpinned_refs() const {
+    return header && (header->use_count() > header->pins);
+  }
 
   BufChunk slice(size_t slice_off,
                  size_t slice_len = std::dynamic_extent) const {
@@ -57,19 +188,75 @@ public:
       slice_len = _size - slice_off;
     assert(slice_len <= _size);
 
-    BufChunk sliced;
-    sliced.data = data;
+    BufChunk sliced(*this);
     sliced.offset = offset + slice_off;
     sliced._size = slice_len;
     return sliced;
   }
 
 private:
-  std::shared_ptr<uint8_t[]> data = nullptr;
+  /// Header allocated together with the data it precedes.
+  struct InlineHeader : public ChunkHeader {
+    /// the size reserved for the header, keeping the data cache-line aligned
+    static constexpr size_t SIZE = 64;
+
+    std::pmr::memory_resource *mem;
+    size_t alloc_size;
+
+    static ChunkHeader *create(size_t size, std::pmr::memory_resource *mem) {
+      static_assert(sizeof(InlineHeader) <= SIZE);
+      size_t alloc_size = SIZE + size;
+      auto *storage = static_cast<uint8_t *>(
+          mem->allocate(alloc_size, alignof(std::max_align_t)));
+      auto *hdr = new (storage) InlineHeader;
+      hdr->data = storage + SIZE;
+      hdr->destroy = &InlineHeader::destroy_fn;
+      hdr->mem = mem;
+      hdr->alloc_size = alloc_size;
+      std::memset(hdr->data, 0, size);
+      return hdr;
+    }
+
+    static void destroy_fn(ChunkHeader *base) {
+      auto *hdr = static_cast<InlineHeader *>(base);
+      std::pmr::memory_resource *mem = hdr->mem;
+      size_t alloc_size = hdr->alloc_size;
+      hdr->~InlineHeader();
+      mem->deallocate(hdr, alloc_size, alignof(std::max_align_t));
+    }
+  };
+
+  /// Separately allocated header of a user-supplied buffer.
+  template <typename Deleter> struct ExternalHeader : public ChunkHeader {
+    Deleter deleter;
+
+    explicit ExternalHeader(Deleter deleter) : deleter(std::move(deleter)) {}
+
+    static ChunkHeader *create(uint8_t *ptr, Deleter deleter) {
+      auto *hdr = new ExternalHeader(std::move(deleter));
+      hdr->data = ptr;
+      hdr->destroy = &ExternalHeader::destroy_fn;
+      return hdr;
+    }
+
+    static void destroy_fn(ChunkHeader *base) {
+      auto *hdr = static_cast<ExternalHeader *>(base);
+      hdr->deleter(hdr->data);
+      delete hdr;
+    }
+  };
+
+  uint8_t *data() const { return header ? header->data : nullptr; }
+
+  ChunkHeader *header = nullptr;
   size_t offset = 0;
   size_t _size = 0;
 };
 
+/// A chunk is only a pointer to the shared header together with a slice
+/// description, so it can be moved in memory without adjusting the refcount.
+template <> struct IsTriviallyRelocatable<BufChunk> : std::true_type {};
+
 /// A non-contiguous buffer.
 ///
 /// Consists of a variable amount of chunks ([BufChunk] instances), which are
@@ -86,6 +273,8 @@ class Buf {
   /// the number of chunks to store in the class without resorting to further
   /// allocations
   static const size_t SMALL_CHUNK_COUNT = 4;
+  /// the number of chunks from which [seek] uses the chunk offset index
+  static const size_t INDEX_THRESHOLD = 16;
 
 public:
   template<typename Ti>
@@ -97,8 +286,7 @@ public:
     using reference = uint8_t &;
 
   private:
-    using ChunkVecType = SmallVec<BufChunk, SMALL_CHUNK_COUNT>;
-    using ChunkItType = std::conditional_t<std::is_const_v<Ti>, ChunkVecType::const_iterator, ChunkVecType::iterator>;
+    using ChunkItType = std::conditional_t<std::is_const_v<Ti>, const BufChunk *, BufChunk *>;
   public:
     Iterator() = default;
     Iterator(ChunkItType chunk_it, size_t chunk_off) : chunk_off(chunk_off), chunk_it(chunk_it) {}
@@ -224,15 +412,22 @@ private:
   iterator masked_start;
   size_t mask_off = 0;
   size_t n_holes = 0;
+  /// the resource used for chunks allocated by the buffer itself
+  std::pmr::memory_resource *mem = std::pmr::get_default_resource();
+  /// the start offsets of the chunks (including the masked part) for long
+  /// chains, built on demand by [seek] and cleared when out of date
+  std::vector<size_t> chunk_starts;
 
 public:
-  template <class Alloc = std::pmr::polymorphic_allocator<std::byte>>
-  explicit Buf(size_t size,
-               const Alloc &alloc = std::pmr::polymorphic_allocator())
-      : _size(size), masked_start(begin(false)) {
+  using allocator_type = std::pmr::polymorphic_allocator<std::byte>;
+
+  explicit Buf(size_t size, const allocator_type &alloc = {})
+      : _size(size), masked_start(begin(false)), mem(alloc.resource()) {
     chunks.emplace_back(size, alloc);
   }
-  explicit Buf(BufChunk chunk) : chunks({chunk}), masked_start(begin(false)) {}
+  explicit Buf(BufChunk chunk, const allocator_type &alloc = {})
+      : chunks({chunk}), _size(chunk.size()), masked_start(begin(false)),
+        mem(alloc.resource()) {}
   Buf() : chunks({}), masked_start(begin(false)) {};
 
   // the buffer doesn't own the underlying buffers, we can therefore make it
@@ -241,58 +436,72 @@ public:
   Buf &operator=(const Buf &other) {
     chunks = other.chunks;
     _size = other._size;
-    masked_start = iterator {chunks.begin() + other.masked_start.chunk_it.idx, other.masked_start.chunk_off};
+    masked_start = iterator {chunks.begin() + other.chunk_index(other.masked_start), other.masked_start.chunk_off};
     mask_off = other.mask_off;
     n_holes = other.n_holes;
+    mem = other.mem;
+    chunk_starts.clear();
     return *this;
   }
   Buf(const Buf &other) { *this = other; }
   Buf &operator=(Buf &&other) {
+    if (this == &other)
+      return *this;
+    size_t masked_idx = other.chunk_index(other.masked_start);
     chunks = std::move(other.chunks);
     _size = other._size;
-    masked_start = iterator {chunks.begin() + other.masked_start.chunk_it.idx, other.masked_start.chunk_off};
+    masked_start = iterator {chunks.begin() + masked_idx, other.masked_start.chunk_off};
     mask_off = other.mask_off;
     n_holes = other.n_holes;
+    mem = other.mem;
+    chunk_starts.clear();
+    // leave the moved-from buffer empty, but usable
+    other._size = 0;
+    other.mask_off = 0;
+    other.n_holes = 0;
+    other.masked_start = other.begin(false);
     return *this;
   }
-  Buf(Buf &&other) { *this = other; }
+  Buf(Buf &&other) { *this = std::move(other); }
 
   /// Reserve a _contiguous_ chunk of a given size directly before the currently
   /// masked position. If the masked part of the current chunk is not
-  /// sufficient, allocates a new chunk and replaces (without copying) the
-  /// appropriate preceding chunks.
+  /// sufficient or is shared with other buffers, allocates a new chunk (using
+  /// the buffer's allocator) and replaces (without copying) the appropriate
+  /// preceding chunks. The reserved bytes can therefore always be written to
+  /// without affecting the copies of the buffer.
   void reserve_before(size_t res_size) {
-    if (masked_start.chunk_off >= res_size)
+    if (has_room_before(res_size))
       return; // the current chunk is sufficient
+    replace_masked(BufChunk(res_size, get_allocator()));
+  }
 
-    size_t erased_size;
-    iterator insert_pos;
-    if (mask_off >= res_size) {
-      auto erase_start = masked_start - res_size;
-      erased_size = res_size;
-      masked_start.chunk_it =
-          chunks.erase(erase_start.chunk_it + 1, masked_start.chunk_it);
-      masked_start.chunk() = masked_start.chunk().slice(masked_start.chunk_off);
-      masked_start.chunk_off = 0; // truncate the current chunk from the head
-      erase_start.chunk() = erase_start.chunk().slice(
-          0, erase_start
-                 .chunk_off); // truncate the new preceding chunk from the tail
-      insert_pos = erase_start;
-    } else {
-      erased_size = mask_off;
-      masked_start.chunk_it =
-          chunks.erase(begin(false).chunk_it, masked_start.chunk_it);
-      masked_start.chunk() = masked_start.chunk().slice(masked_start.chunk_off);
-      masked_start.chunk_off = 0; // truncate the current chunk from the head
-      insert_pos = begin(false);
-    }
-    _size -= erased_size;
-    mask_off -= erased_size;
+  /// Like [reserve_before], but uses the supplied `res_chunk` (of size exactly
+  /// `res_size`) instead of allocating a new one.
+  void reserve_before(size_t res_size, const BufChunk &res_chunk) {
+    assert(res_chunk.size() == res_size);
+    if (has_room_before(res_size))
+      return;
+    replace_masked(res_chunk);
+  }
 
-    // allocate and insert the new contiguous chunk
-    masked_start.chunk_it = chunks.emplace(insert_pos.chunk_it, res_size) + 1;
-    _size += res_size;
-    mask_off += res_size;
+  /// Make the `size` masked bytes directly before the masked position
+  /// writable: if they are shared with other buffers (see
+  /// [BufChunk::is_unique]) or not contiguous, they are copied into a new
+  /// chunk replacing them.
+  void unshare_before(size_t size) {
+    assert(size <= mask_off);
+    if (has_room_before(size))
+      return;
+    BufChunk copy(size, get_allocator());
+    size_t copied = 0;
+    for (auto it = masked_start - size; copied < size; it = it.next_chunk()) {
+      std::span<uint8_t> span = it.contiguous();
+      size_t n = std::min(span.size(), size - copied);
+      std::memcpy(copy.begin() + copied, span.data(), n);
+      copied += n;
+    }
+    replace_masked(copy);
   }
 
   void mask(size_t mask_size) {
@@ -309,6 +518,10 @@ public:
 
   /// Return the current size of the unmasked part
   size_t size() const { return _size - mask_off; }
+  /// Return the number of masked bytes before the unmasked part.
+  size_t masked_size() const { return mask_off; }
+  /// Return the size of the buffer including its masked part.
+  size_t total_size() const { return _size; }
 
   enum class InsertError { OVERLAPPING_LEFT, OVERLAPPING_RIGHT };
 
@@ -323,83 +536,75 @@ public:
   /// [InsertError::OVERLAPPING_RIGHT] is returned.
   Result<iterator, InsertError> insert_chunk(const BufChunk &chunk,
                                              size_t offset) {
-    if (offset >= size()) {
-      // we expect to find a hole at the offset, so create one if we are
-      // inserting beyond the end of the buffer
-      size_t end_hole_size = offset + chunk.size() - size();
-      chunks.emplace_back(BufChunk::empty(end_hole_size));
-      _size += end_hole_size;
-      n_holes += 1;
-    }
-
-    auto insert_hole_it = masked_start + offset;
-    if (!insert_hole_it.is_hole())
-      return ResultError(InsertError::OVERLAPPING_LEFT);
-    size_t insert_hole_size = insert_hole_it.chunk().size();
-    size_t left_hole_size = insert_hole_it.chunk_off;
-    ssize_t right_hole_size =
-        insert_hole_size - (left_hole_size + chunk.size());
-    if (right_hole_size < 0)
-      return ResultError(InsertError::OVERLAPPING_RIGHT);
-
-    insert_hole_it.chunk_off = 0;
-    if ((left_hole_size == 0) &&
-        (right_hole_size > 0)) { // left-aligned insertion
-      chunks.emplace(insert_hole_it.chunk_it + 1,
-                     BufChunk::empty(right_hole_size));
-      insert_hole_it.chunk() = chunk;
-    } else if ((left_hole_size > 0) &&
-               (right_hole_size == 0)) { // right-aligned insertion
-      chunks.emplace(insert_hole_it.chunk_it + 1, chunk);
-      insert_hole_it.chunk() = BufChunk::empty(left_hole_size);
-      insert_hole_it = insert_hole_it.next_chunk();
-    } else if ((left_hole_size == 0) &&
-               (right_hole_size == 0)) { // full-aligned insertion
-      insert_hole_it.chunk() = chunk;
-      n_holes -= 1;
-    } else { // strictly-inside-hole insertion
-      chunks.emplace(insert_hole_it.chunk_it + 1,
-                     BufChunk::empty(right_hole_size));
-      auto new_left_hole_it = chunks.emplace(insert_hole_it.chunk_it,
-                                             BufChunk::empty(left_hole_size));
-      insert_hole_it.chunk_it = new_left_hole_it + 1;
-      insert_hole_it.chunk() = chunk;
-      n_holes += 1;
-    }
-
-    masked_start = insert_hole_it - offset;
-    return insert_hole_it;
+    extend_for_insert(offset, chunk.size());
+    return insert_chunk_at(seek(offset), chunk);
   }
 
   /// Insert a [Buf] into the buffer at `offset` given relative to the currently
-  /// unmasked part.
+  /// unmasked part, inserting at most `length` bytes.
   ///
   /// Only the unmasked part of `other_buf` is inserted. The insertion is
-  /// performed by repeatedly calling [insert_chunk].
+  /// performed chunk by chunk as in [insert_chunk], continuing each insertion
+  /// directly after the previously inserted chunk.
   Result<iterator, InsertError> insert(Buf &other_buf, size_t offset,
                                        size_t length = std::dynamic_extent) {
     auto chunk_it = other_buf.begin();
-    size_t inserted_size = offset;
-    Iterator result_it = begin() + std::min(size(), offset);
-    // TODO: do not make [insert_chunk] recompute the insertion iterator on each
-    // call
+    std::optional<iterator> result_it;
+    size_t inserted_size = 0;
+    // index of the chunk following the previously inserted one
+    std::optional<size_t> next_idx;
     while ((chunk_it != other_buf.end()) && (inserted_size < length)) {
       BufChunk chunk = chunk_it.sliced_chunk();
-      if (chunk.size() == 0) {
-        chunk_it = chunk_it.next_chunk();
+      chunk_it = chunk_it.next_chunk();
+      if (chunk.size() == 0)
         continue;
-      }
-      if (chunk.size() + inserted_size > length)
+      if (chunk.size() > length - inserted_size)
         chunk = chunk.slice(0, length - inserted_size);
-      auto insert_res = insert_chunk(chunk, inserted_size);
+
+      size_t chunk_offset = offset + inserted_size;
+      extend_for_insert(chunk_offset, chunk.size());
+      iterator insert_it = next_idx.has_value()
+                               ? iterator{chunks.begin() + *next_idx, 0}
+                               : seek(chunk_offset);
+      auto insert_res = insert_chunk_at(insert_it, chunk);
       if (insert_res.has_error())
         return insert_res;
-      if (chunk_it == other_buf.begin())
+      if (!result_it.has_value())
         result_it = insert_res.value();
+      next_idx = chunk_index(insert_res.value()) + 1;
       inserted_size += chunk.size();
-      chunk_it = chunk_it.next_chunk();
     }
-    return result_it;
+    if (!result_it.has_value())
+      return seek(std::min(size(), offset));
+    return *result_it;
+  }
+
+  /// Return an iterator `offset` bytes after the start of the unmasked part.
+  ///
+  /// For long chunk chains, a cached index of the chunk offsets is used,
+  /// making the seek logarithmic in the number of chunks instead of linear.
+  iterator seek(size_t offset) {
+    assert(offset <= size());
+    if (chunks.size() < INDEX_THRESHOLD)
+      return masked_start + offset;
+
+    if (chunk_starts.size() != chunks.size())
+      build_index();
+    size_t buf_offset = mask_off + offset;
+    if (buf_offset == _size)
+      return end();
+    auto start_it = std::ranges::upper_bound(chunk_starts, buf_offset) - 1;
+    size_t chunk_idx = start_it - chunk_starts.begin();
+    return {chunks.begin() + chunk_idx, buf_offset - *start_it};
+  }
+
+  /// Return an iterator `buf_offset` bytes after the start of the buffer,
+  /// including the masked part.
+  iterator at(size_t buf_offset) {
+    assert(buf_offset <= _size);
+    if (buf_offset >= mask_off)
+      return seek(buf_offset - mask_off);
+    return begin(false) + buf_offset;
   }
 
   iterator begin(bool masked = true) {
@@ -422,31 +627,122 @@ public:
     return {chunks.end(), 0};
   }
 
+  /// Return the allocator used for the chunks allocated by the buffer itself
+  /// (e.g. in [reserve_before] or [as_contiguous]).
+  allocator_type get_allocator() const { return allocator_type(mem); }
+
   bool is_contiguous() const { return chunks.size() == 1; }
+  /// Return the number of chunks (including the holes and the masked ones).
+  size_t chunk_count() const { return chunks.size(); }
   bool is_complete() const { return n_holes == 0; }
 
+  /// Describe the unmasked part of the buffer by `iovec` entries (one per
+  /// non-empty chunk), e.g. for vectored I/O. The buffer must be complete.
+  ///
+  /// Returns the number of entries needed to describe the whole buffer, of
+  /// which only the first `iov.size()` are filled.
+  size_t to_iovec(std::span<iovec> iov) const {
+    assert(is_complete());
+    size_t n_segs = 0;
+    for (auto it = begin(); it != end(); it = it.next_chunk()) {
+      const BufChunk &chunk = *it.chunk_it;
+      if (chunk.size() == it.chunk_offset())
+        continue;
+      if (n_segs < iov.size())
+        iov[n_segs] = {const_cast<uint8_t *>(chunk.begin()) + it.chunk_offset(),
+                       chunk.size() - it.chunk_offset()};
+      n_segs++;
+    }
+    return n_segs;
+  }
+
+  /// Return the number of entries [to_iovec] needs for the buffer.
+  size_t segment_count() const { return to_iovec({}); }
+
+  /// Copy the unmasked part of the buffer to `dst`, returning the partial
+  /// internet checksum of the copied data (see [csum_copy]). The buffer must be
+  /// complete.
+  uint64_t copy_csum(uint8_t *dst) const {
+    assert(is_complete());
+    uint64_t sum = 0;
+    size_t offset = 0;
+    for (auto it = begin(); it != end(); it = it.next_chunk()) {
+      const BufChunk &chunk = *it.chunk_it;
+      std::span<const uint8_t> data(chunk.begin() + it.chunk_offset(),
+                                    chunk.size() - it.chunk_offset());
+      uint64_t chunk_sum = csum_copy(data, dst + offset);
+      // the words of chunks starting at odd offsets straddle the chunk boundary
+      sum = csum_fold(sum) + ((offset & 1) ? csum_shift(chunk_sum) : chunk_sum);
+      offset += data.size();
+    }
+    return sum;
+  }
+
   /// Create a contiguous (single-chunk) version of the unmasked part of the
   /// buffer. May allocate a new contiguous backing [BufChunk]. Does not
   /// guarantee to keep the masked part of the buffer.
-  Buf as_contiguous() const {
-    if (is_contiguous())
+  ///
+  /// If `sum` is given, the partial internet checksum of the data is stored to
+  /// it, computed while copying the data (see [copy_csum]).
+  Buf as_contiguous(uint64_t *sum = nullptr) const {
+    if (is_contiguous()) {
+      if (sum)
+        *sum = csum_partial(begin().contiguous());
       return *this;
-    Buf contig_buf(size());
-    std::ranges::copy(*this, contig_buf.begin());
+    }
+    Buf contig_buf(size(), get_allocator());
+    if (sum)
+      *sum = copy_csum(contig_buf.begin().contiguous().data());
+    else
+      std::ranges::copy(*this, contig_buf.begin());
     return contig_buf;
   }
 
+  /// Merge each run of adjacent non-hole chunks smaller than `threshold` bytes
+  /// in the unmasked part of the buffer into a single newly allocated chunk.
+  /// Returns the number of chunks removed from the buffer.
+  size_t compact(size_t threshold) {
+    size_t removed = 0;
+    size_t idx = chunk_index(masked_start) + (masked_start.chunk_off > 0);
+    while (idx < chunks.size()) {
+      size_t run_end = idx;
+      size_t run_size = 0;
+      while ((run_end < chunks.size()) && !chunks[run_end].is_empty() &&
+             (chunks[run_end].size() < threshold)) {
+        run_size += chunks[run_end].size();
+        run_end++;
+      }
+      if (run_end - idx < 2) {
+        idx = std::max(run_end, idx + 1);
+        continue;
+      }
+
+      BufChunk merged(run_size, get_allocator());
+      uint8_t *merged_it = merged.begin();
+      for (size_t i = idx; i < run_end; i++)
+        merged_it = std::ranges::copy(chunks[i], merged_it).out;
+      chunks.erase(chunks.begin() + idx + 1, chunks.begin() + run_end);
+      chunks[idx] = std::move(merged);
+      removed += run_end - idx - 1;
+      idx++;
+    }
+    if (removed > 0)
+      chunk_starts.clear();
+    return removed;
+  }
+
   /// Truncate the unmasked part of the buffer.
   void truncate(size_t new_size) {
     if (new_size >= size())
       return;
+    chunk_starts.clear();
     if (new_size == 0) {
       masked_start.chunk_it = chunks.erase(masked_start.chunk_it, chunks.end());
       masked_start.chunk_off = 0;
       _size = mask_off;
       return;
     }
-    auto end_it = begin() + new_size;
+    auto end_it = seek(new_size);
     for (auto it = end_it.next_chunk(); it != end(); it++) {
       if (it.is_hole())
         n_holes -= 1;
@@ -457,5 +753,151 @@ public:
       chunks.erase(end_it.chunk_it, end_it.chunk_it + 1);
     _size = new_size + mask_off;
   }
+
+  /// Whether there are `res_size` contiguous masked bytes directly before the
+  /// masked position, which are not shared with any other buffer. When the
+  /// masked position is at a chunk boundary, the preceding chunk is checked
+  /// instead.
+  bool has_room_before(size_t res_size) const {
+    if (res_size == 0)
+      return true;
+    if (masked_start.chunk_off >= res_size)
+      return (*masked_start.chunk_it).is_unique();
+    if ((masked_start.chunk_off > 0) || (mask_off == 0))
+      return false;
+    const BufChunk &prev_chunk = *(masked_start.chunk_it - 1);
+    return prev_chunk.is_unique() && (prev_chunk.size() >= res_size);
+  }
+
+private:
+  /// If inserting `size` bytes at `offset` of the unmasked part would reach
+  /// past the end of the buffer, extend the buffer by a hole.
+  void extend_for_insert(size_t offset, size_t size) {
+    if (offset < this->size())
+      return;
+    // we expect to find a hole at the offset, so create one if we are
+    // inserting beyond the end of the buffer
+    size_t end_hole_size = offset + size - this->size();
+    index_insert(chunks.size(), {_size});
+    emplace_chunk(chunks.size(), BufChunk::empty(end_hole_size));
+    _size += end_hole_size;
+    n_holes += 1;
+  }
+
+  /// Insert `chunk` into the hole at `insert_hole_it`, as described in
+  /// [insert_chunk].
+  Result<iterator, InsertError> insert_chunk_at(iterator insert_hole_it,
+                                                const BufChunk &chunk) {
+    if ((insert_hole_it == end()) || !insert_hole_it.is_hole())
+      return ResultError(InsertError::OVERLAPPING_LEFT);
+    size_t insert_hole_size = insert_hole_it.chunk().size();
+    size_t left_hole_size = insert_hole_it.chunk_off;
+    ssize_t right_hole_size =
+        insert_hole_size - (left_hole_size + chunk.size());
+    if (right_hole_size < 0)
+      return ResultError(InsertError::OVERLAPPING_RIGHT);
+
+    size_t hole_idx = chunk_index(insert_hole_it);
+    size_t hole_start =
+        (chunk_starts.size() == chunks.size()) ? chunk_starts[hole_idx] : 0;
+    size_t inserted_idx = hole_idx;
+    if ((left_hole_size == 0) &&
+        (right_hole_size > 0)) { // left-aligned insertion
+      index_insert(hole_idx + 1, {hole_start + chunk.size()});
+      emplace_chunk(hole_idx + 1, BufChunk::empty(right_hole_size));
+      chunks[hole_idx] = chunk;
+    } else if ((left_hole_size > 0) &&
+               (right_hole_size == 0)) { // right-aligned insertion
+      index_insert(hole_idx + 1, {hole_start + left_hole_size});
+      emplace_chunk(hole_idx + 1, chunk);
+      chunks[hole_idx] = BufChunk::empty(left_hole_size);
+      inserted_idx = hole_idx + 1;
+    } else if ((left_hole_size == 0) &&
+               (right_hole_size == 0)) { // full-aligned insertion
+      chunks[hole_idx] = chunk;
+      n_holes -= 1;
+    } else { // strictly-inside-hole insertion
+      index_insert(hole_idx + 1, {hole_start + left_hole_size,
+                                  hole_start + left_hole_size + chunk.size()});
+      emplace_chunk(hole_idx + 1, BufChunk::empty(right_hole_size));
+      emplace_chunk(hole_idx + 1, chunk);
+      chunks[hole_idx] = BufChunk::empty(left_hole_size);
+      inserted_idx = hole_idx + 1;
+      n_holes += 1;
+    }
+
+    // the insertion is never before the masked position, so the only case to
+    // fix up is the masked position pointing to the end of the split left hole
+    if ((chunk_index(masked_start) == hole_idx) && (left_hole_size > 0) &&
+        (masked_start.chunk_off >= left_hole_size)) {
+      masked_start = {chunks.begin() + hole_idx + 1,
+                      masked_start.chunk_off - left_hole_size};
+    }
+    return iterator{chunks.begin() + inserted_idx, 0};
+  }
+
+  /// Return the index of the chunk `it` points into.
+  size_t chunk_index(const_iterator it) const {
+    return it.chunk_it - chunks.begin();
+  }
+
+  /// Emplace `chunk` at index `idx` of the chain, keeping [masked_start] at
+  /// the same index even if the chain gets reallocated.
+  void emplace_chunk(size_t idx, BufChunk chunk) {
+    size_t masked_idx = chunk_index(masked_start);
+    chunks.emplace(chunks.begin() + idx, std::move(chunk));
+    masked_start.chunk_it = chunks.begin() + masked_idx;
+  }
+
+  /// Rebuild the cached start offsets of the chunks used by [seek].
+  void build_index() {
+    chunk_starts.clear();
+    chunk_starts.reserve(chunks.size());
+    size_t start = 0;
+    for (const BufChunk &chunk : chunks) {
+      chunk_starts.push_back(start);
+      start += chunk.size();
+    }
+  }
+
+  /// Record new chunks starting at `starts` at `idx` in the index, if it is
+  /// currently built. Must be called before the chunks are inserted.
+  void index_insert(size_t idx, std::initializer_list<size_t> starts) {
+    if ((chunk_starts.size() == chunks.size()) && !chunk_starts.empty())
+      chunk_starts.insert(chunk_starts.begin() + idx, starts);
+    else
+      chunk_starts.clear();
+  }
+
+  /// Replace the `res_chunk.size()` bytes directly before the masked position
+  /// (or the whole masked part, if it is smaller) by `res_chunk`.
+  void replace_masked(const BufChunk &res_chunk) {
+    size_t res_size = res_chunk.size();
+    size_t erased_size = std::min(mask_off, res_size);
+    iterator erase_start = masked_start - erased_size;
+
+    // keep the head of the first erased chunk (unless it is erased whole) and
+    // the unmasked tail of the current chunk, which may be the same chunk
+    std::optional<BufChunk> head;
+    if (erase_start.chunk_off > 0)
+      head = erase_start.chunk().slice(0, erase_start.chunk_off);
+    if (masked_start.chunk_off > 0) {
+      masked_start.chunk() = masked_start.chunk().slice(masked_start.chunk_off);
+      masked_start.chunk_off = 0;
+    }
+
+    // replace the erased chunks by the kept head and the new contiguous chunk
+    chunk_starts.clear();
+    size_t insert_idx =
+        chunks.erase(erase_start.chunk_it, masked_start.chunk_it) -
+        chunks.begin();
+    masked_start.chunk_it = chunks.begin() + insert_idx;
+    if (head.has_value())
+      emplace_chunk(insert_idx++, std::move(*head));
+    emplace_chunk(insert_idx, res_chunk);
+    masked_start.chunk_it = chunks.begin() + insert_idx + 1;
+    _size += res_size - erased_size;
+    mask_off += res_size - erased_size;
+  }
 };
 } // namespace jay
@@ -1,6 +1,9 @@
 #pragma once
 #include "jay/buf/struct_writer.h"
+#include "jay/util/csum.h"
 #include "jay/util/result.h"
+#include <algorithm>
+#include <array>
 #include <cstddef>
 #include <iostream>
 #include <limits>
@@ -8,6 +11,8 @@
 namespace jay {
 enum class BufError { OUT_OF_BOUNDS, NO_SIZE_HINT };
 
+template <typename T, bool NBO = true> struct Field;
+
 /// CRTP template for representing (de)serializable structures such as
 /// protocol headers. The implementor itself should not store the structure
 /// data, but only a pointer to an underlying buffer, providing transparent
@@ -47,8 +52,28 @@ public:
     return std::numeric_limits<size_t>::max();
   }
 
+  /// Create a view of a structure at `cur`, which has already been validated
+  /// by [read] or created by [construct], without checking it again.
+  static Ts view(StructWriter cur) {
+    Ts strct = Ts{cur};
+    strct.cur = cur.span().subspan(0, strct.size());
+    return strct;
+  }
+
   StructWriter cursor() const { return cur; }
 
+  /// Write `value` to `field` of the structure, patching the internet
+  /// checksum `csum` covering the structure incrementally (see
+  /// [csum_replace]) instead of recomputing it over all the covered data. The
+  /// structure must start at an even offset of the checksummed data.
+  template <typename Tf, bool NBO, bool CsumNBO>
+  void update_field(Field<Tf, NBO> field, const Tf &value,
+                    Field<uint16_t, CsumNBO> csum) const;
+
+  /// Return the offset of `field` from the start of the structure.
+  template <typename Tf, bool NBO>
+  size_t field_offset(Field<Tf, NBO> field) const;
+
 protected:
   BufStruct(StructWriter cur) : cur(cur) {}
   StructWriter cur;
@@ -66,7 +91,7 @@ concept IsBufStruct = std::is_base_of_v<BufStruct<T, typename T::ErrorType>, T>;
 /// - if `T` is [IsBufWriteable]: assignment operator overload for `T`
 /// - if `T` is [IsBufStruct]: `read` and `construct` methods matching the
 /// BufStruct semantics
-template <typename T, bool NBO = true> struct Field {
+template <typename T, bool NBO> struct Field {
   using Type = T;
 
   Field(StructWriter cur) : cur(cur) {};
@@ -118,6 +143,24 @@ template <typename T, bool NBO = true> struct Field {
   StructWriter cur;
 };
 
+template <typename Ts, typename Terr>
+template <typename Tf, bool NBO, bool CsumNBO>
+void BufStruct<Ts, Terr>::update_field(Field<Tf, NBO> field, const Tf &value,
+                                       Field<uint16_t, CsumNBO> csum) const {
+  std::span<uint8_t> bytes = field.cur.span().first(sizeof(Tf));
+  std::array<uint8_t, sizeof(Tf)> old_bytes;
+  std::ranges::copy(bytes, old_bytes.begin());
+  field = value;
+  bool odd = (bytes.data() - cur.span().data()) & 1;
+  csum = csum_replace(csum, old_bytes, bytes, odd);
+}
+
+template <typename Ts, typename Terr>
+template <typename Tf, bool NBO>
+size_t BufStruct<Ts, Terr>::field_offset(Field<Tf, NBO> field) const {
+  return field.cur.span().data() - cur.span().data();
+}
+
 template <typename Ts> struct DefaultTagAccessor {
   static const decltype(Ts::UNION_TAG) TAG = Ts::UNION_TAG;
 };
@@ -3,6 +3,7 @@
 #include "jay/eth.h"
 #include "jay/neigh.h"
 #include "jay/pbuf.h"
+#include <span>
 namespace jay {
 
 class Stack;
@@ -18,10 +19,35 @@ public:
   /// block in doing so.
   virtual void enqueue(PBuf) = 0;
 
+  /// Queue a burst of packets for transmission, as [enqueue] does for each of
+  /// them. The packets are moved out of `packets`. Interfaces able to submit
+  /// several packets at once (e.g. by a single system call) should override
+  /// this; the default hands the packets to [enqueue] one by one.
+  virtual void enqueue_burst(std::span<PBuf> packets) {
+    for (PBuf &packet : packets)
+      enqueue(std::move(packet));
+  }
+
   /// Poll the interface for incoming packets. The [Stack] instance is supplied
   /// as the first argument, on which [Stack::input] shall be called for each
   /// processed incoming packet. The invocation may not block.
-  virtual void poll_rx(Stack &) = 0;
+  ///
+  /// Only called through the default [poll_rx_burst], so interfaces
+  /// overriding that need not override this.
+  virtual void poll_rx(Stack &) {}
+
+  /// Poll the interface for up to `packets.size()` incoming packets, storing
+  /// them to `packets` and returning their number. The [Stack] passes them to
+  /// [Stack::input_burst] together and polls again while the returned bursts
+  /// are full. The invocation may not block.
+  ///
+  /// The default adapts single-packet interfaces: it calls [poll_rx], which
+  /// passes the packets to [Stack::input] itself, and returns 0.
+  virtual size_t poll_rx_burst(Stack &stack, std::span<PBuf> packets) {
+    (void)packets;
+    poll_rx(stack);
+    return 0;
+  }
 
   /// Poll the interface for transmission of queued packets. When invoked, the
   /// queue should be checked for packets that have been transmitted, freeing
@@ -35,6 +61,42 @@ public:
   
   /// Returns the maximum size of packet (excluding the Ethernet) header the the interface can transmit.
   virtual uint16_t mtu() const noexcept = 0;
+
+  /// Returns whether the interface can transmit packets consisting of
+  /// multiple chunks without linearizing them first (e.g. using
+  /// [Buf::to_iovec] and vectored I/O). Packets for interfaces without
+  /// scatter-gather support are linearized by the [Stack] before being
+  /// enqueued.
+  virtual bool scatter_gather() const noexcept { return false; }
+
+  /// Returns the maximum number of segments (see [Buf::segment_count]) of a
+  /// packet the interface can transmit when it supports scatter-gather.
+  /// Longer chains are compacted or linearized by the [Stack].
+  virtual size_t max_segments() const noexcept { return 1; }
+
+  /// Returns whether the interface reports packets whose checksums have been
+  /// verified by the device (see [PBufStruct::rx_csum_valid]). The flag is
+  /// ignored on packets received on interfaces without this capability.
+  virtual bool rx_csum_offload() const noexcept { return false; }
+
+  /// Returns whether the interface can complete the transport checksum of the
+  /// transmitted packets (see [PBufStruct::tx_csum_partial]). If so, the
+  /// [Stack] leaves the checksum to the interface instead of computing it.
+  virtual bool tx_csum_offload() const noexcept { return false; }
+
+  /// Returns the maximum size of an IP packet (including the IP header) the
+  /// interface accepts beyond its MTU, fragmenting it itself (see
+  /// [PBufStruct::gso_size]), or 0 if it can't. The [Stack] hands UDP
+  /// datagrams up to this size to the interface whole instead of fragmenting
+  /// them.
+  virtual size_t gso_max_size() const noexcept { return 0; }
+
+  /// Returns the number of bytes the interface needs in front of the Ethernet
+  /// header of the transmitted packets (e.g. for encapsulation or
+  /// device-specific headers). The packets allocated by the [Stack] reserve
+  /// this room in addition to its base headroom, so that such headers can be
+  /// prepended in place.
+  virtual size_t headroom() const noexcept { return 0; }
   NeighCache neighbours;
   
   std::array<uint8_t, 8> ident() const {
@@ -0,0 +1,213 @@
+#pragma once
+
+#include "jay/if.h"
+#include <array>
+#include <memory_resource>
+#include <span>
+#include <string>
+#include <sys/uio.h>
+#include <vector>
+
+struct io_uring_sqe;
+struct io_uring_cqe;
+
+namespace jay {
+/// A TAP interface driven by io_uring.
+///
+/// Frames are received by a multishot read into a ring of provided buffers
+/// (see `IORING_REGISTER_PBUF_RING`) allocated from the stack's packet memory.
+/// The received frames are handed to the stack without copying, and a buffer
+/// is given back to the kernel once the last reference to its frame is
+/// dropped. Transmitted packets are queued as vectored writes of their chunks,
+/// which are submitted together on the next poll.
+///
+/// A poll cycle makes at most two `io_uring_enter` system calls: [poll_rx_burst]
+/// submits the writes queued so far and collects the completions at once, and
+/// [poll_tx] submits the writes queued since (such as the replies to the
+/// received frames), if any. Packets enqueued outside of [Stack::poll] are thus
+/// transmitted on the next poll.
+///
+/// Kernels without multishot reads (before Linux 6.7) fall back to single-shot
+/// reads with buffer selection, keeping several of them in flight. On kernels
+/// supporting it (Linux 6.1), the ring is restricted to a single issuer, so the
+/// interface must always be polled from the same thread (the first one to poll
+/// it, which need not be the one that created it).
+///
+/// With [Options::multi_queue], the instance attaches as one queue of a
+/// multi-queue TAP device, to which the other queues attach as separate
+/// instances. The kernel spreads the flows over the queues, so that each
+/// queue can be added to a [Stack] shard of its own (with the same addresses
+/// as the other shards) and polled by a thread of its own. The shards resolve
+/// their neighbours separately, while the kernel may steer the replies to
+/// another queue, so static neighbour entries may be needed. The received
+/// packets reference the receive buffers of their queue, so they must be
+/// released on the thread polling it, which holds if each shard (including its
+/// [Stack::mem], from which the buffers should be allocated) stays on its
+/// thread.
+///
+/// With [Options::vnet_hdr], every frame is preceded by a `virtio_net_hdr`
+/// carrying its offload metadata, through which the kernel and jay leave
+/// work to each other. The transport checksums of the transmitted packets are
+/// completed by the kernel (see [PBufStruct::tx_csum_partial]), and UDP
+/// datagrams larger than the MTU are written whole, to be fragmented by the
+/// kernel (see [PBufStruct::gso_size]). The received frames report checksums
+/// verified by the kernel or left partial by the host, which are recorded as
+/// such (see [PBufStruct::rx_csum_valid]) and completed if the packets are
+/// forwarded to an interface which can't complete them. If the receive
+/// buffers fit one, the host may also send a UDP super-packet of several
+/// datagrams (`UDP_SEGMENT`, Linux 6.2), which is split into the datagrams
+/// on reception, all of them referencing its buffer.
+class IoUringTapInterface : public Interface {
+public:
+  struct Options {
+    /// entries of the submission queue (the completion queue has twice as
+    /// many), which also bounds the number of writes in flight
+    unsigned queue_depth = 256;
+    /// number of receive buffers, a power of two
+    uint16_t rx_buffers = 256;
+    /// size of each receive buffer, which bounds the received frame size
+    size_t rx_buffer_size = 2048;
+    /// attach as one of the queues of a multi-queue device (`IFF_MULTI_QUEUE`),
+    /// which all the instances attached to the device must do
+    bool multi_queue = false;
+    /// exchange the offload metadata with the kernel (`IFF_VNET_HDR`); the
+    /// received super-packets are only enabled by receive buffers of at least
+    /// [RX_GSO_BUFFER_SIZE] bytes
+    bool vnet_hdr = false;
+  };
+
+  /// size of the receive buffers fitting the largest super-packet, after its
+  /// `virtio_net_hdr` and Ethernet header
+  static constexpr size_t RX_GSO_BUFFER_SIZE = 10 + EthHeader::SIZE + (1 << 16);
+
+  struct Stats {
+    /// `io_uring_enter` system calls made
+    size_t enters = 0;
+    /// frames received
+    size_t rx_packets = 0;
+    /// received super-packets, counted once in [rx_packets]
+    size_t rx_gso_packets = 0;
+    /// reads that failed or found no free receive buffer, and malformed frames
+    size_t rx_errors = 0;
+    /// packets transmitted
+    size_t tx_packets = 0;
+    /// packets left to the kernel to fragment, counted in [tx_packets] as well
+    size_t tx_gso_packets = 0;
+    /// packets dropped because the queue was full or the write failed
+    size_t tx_errors = 0;
+  };
+
+  /// Create the TAP interface `if_name` (or attach to it, if it exists) and
+  /// set up the ring. The receive buffers are allocated from `mem`, which must
+  /// outlive all the received packets (e.g. [Stack::mem]). Throws
+  /// [std::system_error] if any of the set-up steps fails.
+  IoUringTapInterface(std::string if_name, HWAddr hwaddr, uint16_t mtu,
+                      Options opts,
+                      std::pmr::memory_resource *mem =
+                          std::pmr::get_default_resource());
+  IoUringTapInterface(std::string if_name, HWAddr hwaddr, uint16_t mtu = 1500)
+      : IoUringTapInterface(std::move(if_name), hwaddr, mtu, Options{}) {}
+  IoUringTapInterface(const IoUringTapInterface &) = delete;
+  IoUringTapInterface &operator=(const IoUringTapInterface &) = delete;
+  ~IoUringTapInterface() override;
+
+  void enqueue(PBuf packet) override;
+  void enqueue_burst(std::span<PBuf> packets) override;
+  size_t poll_rx_burst(Stack &stack, std::span<PBuf> packets) override;
+  void poll_tx(Stack &stack) override;
+
+  HWAddr addr() const noexcept override { return _hwaddr; }
+  uint16_t mtu() const noexcept override { return _mtu; }
+  bool scatter_gather() const noexcept override { return true; }
+  size_t max_segments() const noexcept override { return MAX_SEGMENTS; }
+  bool rx_csum_offload() const noexcept override { return opts.vnet_hdr; }
+  bool tx_csum_offload() const noexcept override { return opts.vnet_hdr; }
+  size_t gso_max_size() const noexcept override {
+    return opts.vnet_hdr ? 0xffff : 0;
+  }
+
+  const Stats &stats() const { return _stats; }
+
+private:
+  static constexpr size_t MAX_SEGMENTS = 16;
+
+  class RxBuffers;
+  /// The `virtio_net_hdr` preceding the frames with [Options::vnet_hdr], in
+  /// native byte order (`<linux/virtio_net.h>` doesn't compile as C++).
+  struct VnetHdr {
+    uint8_t flags;
+    uint8_t gso_type;
+    uint16_t hdr_len;
+    uint16_t gso_size;
+    uint16_t csum_start;
+    uint16_t csum_offset;
+  };
+  /// A queued or in-flight write.
+  struct TxSlot {
+    PBuf packet{nullptr};
+    VnetHdr vnet;
+    /// the segments of the packet, preceded by [vnet] with [Options::vnet_hdr]
+    std::array<iovec, MAX_SEGMENTS + 1> iov;
+  };
+
+  void setup_ring(unsigned entries);
+  void arm_rx();
+  io_uring_sqe *get_sqe();
+  /// Submit the queued entries and collect the completions by a single
+  /// `io_uring_enter`, unless there is nothing to submit and some completions
+  /// are already waiting.
+  void enter();
+  void complete_tx(const io_uring_cqe &cqe);
+  /// Hand the frame received with [Options::vnet_hdr] to `packets`, returning
+  /// the number of packets stored.
+  size_t rx_vnet_frame(Stack &stack, BufChunk frame, std::span<PBuf> packets);
+  /// Store the next datagrams of [rx_gso] to `packets`, returning their
+  /// number.
+  size_t rx_gso_segments(Stack &stack, std::span<PBuf> packets);
+  void teardown();
+
+  std::string if_name;
+  HWAddr _hwaddr;
+  uint16_t _mtu;
+  Options opts;
+  int tap_fd = -1;
+  int ring_fd = -1;
+  /// whether the ring waits to be enabled by the polling thread
+  bool ring_disabled = false;
+  /// whether the running kernel supports multishot reads
+  bool rx_multishot = true;
+  /// reads armed (a multishot read counts as one)
+  unsigned rx_armed = 0;
+  /// whether the current poll cycle has entered the kernel already, until
+  /// [poll_rx_burst] returns a short burst
+  bool cycle_entered = false;
+
+  // the mapped rings (see io_uring_setup(2))
+  void *sq_ring = nullptr;
+  size_t sq_ring_size = 0;
+  void *cq_ring = nullptr;
+  size_t cq_ring_size = 0;
+  io_uring_sqe *sqes = nullptr;
+  size_t sqes_size = 0;
+  unsigned *sq_head, *sq_tail, *sq_array, sq_mask, sq_entries;
+  unsigned *cq_head, *cq_tail, cq_mask;
+  io_uring_cqe *cqes;
+  /// the locally queued SQ tail, published to the kernel on [enter]
+  unsigned sq_local_tail = 0;
+
+  /// the received super-packet being split, with the length of its headers,
+  /// the payload size of its datagrams and the offset of the next one
+  struct {
+    BufChunk frame;
+    size_t hdr_len = 0;
+    size_t gso_size = 0;
+    size_t offset = 0;
+    uint16_t n_segments = 0;
+  } rx_gso;
+
+  RxBuffers *rx_bufs = nullptr;
+  std::vector<TxSlot> tx_slots;
+  std::vector<uint32_t> free_tx_slots;
+  Stats _stats;
+};
+} // namespace jay
@@ -2,6 +2,7 @@
 
 #include "jay/buf/sbuf.h"
 #include "jay/eth.h"
+#include "jay/util/csum.h"
 #include "jay/util/trie.h"
 #include <array>
 #include <cstdint>
@@ -11,28 +12,20 @@
 
 namespace jay::ip {
 inline uint16_t inet_csum(std::span<const uint8_t> data, uint32_t init_sum = 0) {
-  if (data.size() > 65535)
-    throw std::out_of_range(
-        "internet checksum of data of size >65536 is not implemented");
-  std::span<const uint16_t> words{reinterpret_cast<const uint16_t *>(data.data()),
-                            data.size() / 2};
-  uint32_t sum =
-      std::accumulate(words.begin(), words.end(), init_sum,
-                      [](uint32_t acc, uint16_t word) { return acc + uint32_t(word); });
-  return ~static_cast<uint16_t>((sum & 0xffff) + (sum >> 16));
+  return ~csum_fold(csum_partial(data, init_sum));
 }
 
 inline uint16_t inet_csum(Buf &buf, uint32_t init_sum = 0) {
-  uint32_t sum = init_sum;
+  uint64_t sum = init_sum;
+  size_t offset = 0;
   for (auto it = buf.begin(); it != buf.end(); it = it.next_chunk()) {
-    std::span<uint16_t> words{
-        reinterpret_cast<uint16_t *>(it.contiguous().data()),
-        it.contiguous().size() / 2};
-    sum += std::accumulate(
-        words.begin(), words.end(), 0,
-        [](uint32_t acc, uint16_t word) { return acc + uint32_t(word); });
-  }
-  return ~static_cast<uint16_t>((sum & 0xffff) + (sum >> 16));
+    std::span<const uint8_t> data = it.contiguous();
+    uint64_t chunk_sum = csum_partial(data);
+    // the words of chunks starting at odd offsets straddle the chunk boundary
+    sum = csum_fold(sum) + ((offset & 1) ? csum_shift(chunk_sum) : chunk_sum);
+    offset += data.size();
+  }
+  return ~csum_fold(sum);
 }
 enum class IPProto : uint8_t { ICMP = 0x1, IGMP = 0x2, UDP = 0x11, ICMPv6 = 58 };
 
@@ -72,6 +72,13 @@ public:
 
   static size_t size_hint() { return 4; }
 
+  /// Like [BufStruct::view], for a header of the given version.
+  static ICMPHeader view(StructWriter cur, IPVersion ver) {
+    ICMPHeader hdr(ver, cur);
+    hdr.cur = cur.span().subspan(0, hdr.size());
+    return hdr;
+  }
+
   template <typename TMsg, typename TCode = uint8_t, typename... CArgT>
   static Result<ICMPHeader, ICMPHeaderError>
   construct(StructWriter cur, IPVersion ver, TMsg &message, TCode code = 0,
@@ -47,10 +47,11 @@ struct IPHeader : public std::variant<IPv4Header, IPv6Header>, JointStruct {
     return IPAddr(src_addr()).sum() + IPAddr(dst_addr()).sum() + __bswap_16(uint16_t(upper_layer_size())) + __bswap_16(static_cast<uint8_t>(protocol));
   }
 
-  static Result<IPHeader, IPHeaderError> read(StructWriter cur, IPVersion ver) {
+  static Result<IPHeader, IPHeaderError> read(StructWriter cur, IPVersion ver,
+                                              bool verify_csum = true) {
     switch (ver) {
       case IPVersion::V4:
-        return IPv4Header::read(cur);
+        return IPv4Header::read(cur, verify_csum);
       case IPVersion::V6:
         return IPv6Header::read(cur);
     }
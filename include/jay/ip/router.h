@@ -1,5 +1,6 @@
 #pragma once
 #include "jay/if.h"
+#include "jay/mem_accounting.h"
 #include "jay/util/trie.h"
 #include "jay/ip/common.h"
 
@@ -21,19 +22,48 @@ public:
     NO_ROUTE
   };
 
+  /// Bytes charged to the [MemAccounting] per destination cache entry.
+  static constexpr size_t DST_ENTRY_SIZE =
+      sizeof(IPAddr) + sizeof(Destination) + 2 * sizeof(void *);
+
   Result<Destination*, Error> route(IPAddr dst_addr) {
-    if (dst_cache.contains(dst_addr))
-      return &dst_cache[dst_addr];
+    auto dst_it = dst_cache.find(dst_addr);
+    if (dst_it != dst_cache.end())
+      return &dst_it->second;
 
-    Destination& dst = dst_cache[dst_addr];
     auto [match_prefix, match_route, _match_len] = rt_table.match_longest(dst_addr);
     if (match_route == nullptr)
       return ResultError(Error::NO_ROUTE);
+
+    // the cache only speeds up the lookups, so it is flushed as a whole when
+    // it exceeds its budget
+    if (!charge_dst()) {
+      flush_dst_cache();
+      if (!charge_dst()) {
+        uncached_dst = Destination{.route = *match_route, .src_iaddr = {}};
+        return &uncached_dst;
+      }
+    }
+    Destination& dst = dst_cache[dst_addr];
     dst.route = *match_route;
 
     return &dst;
   }
 
+  /// Drop all the entries of the destination cache.
+  void flush_dst_cache() {
+    if (accounting)
+      accounting->release(MemSubsystem::DST_CACHE,
+                          dst_cache.size() * DST_ENTRY_SIZE, dst_cache.size());
+    dst_cache.clear();
+  }
+
+  /// Account the destination cache entries to `accounting`. Must be set
+  /// before the first route lookup.
+  void set_accounting(MemAccounting *accounting) {
+    this->accounting = accounting;
+  }
+
   Route* default_route() {
     return rt_table.tree_root();
   }
@@ -79,7 +109,16 @@ public:
     });
   }
 private:
+  bool charge_dst() {
+    return !accounting || accounting->charge(MemSubsystem::DST_CACHE,
+                                             DST_ENTRY_SIZE,
+                                             MemPriority::ESTABLISHED);
+  }
+
   hash_table<IPAddr, Destination> dst_cache;
+  /// result of the last lookup that could not be cached
+  Destination uncached_dst;
+  MemAccounting *accounting = nullptr;
   BitTrie<IPAddr, Route> rt_table;
 };
 }
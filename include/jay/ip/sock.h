@@ -24,13 +24,23 @@ public:
   std::optional<IPAddr> local_addr() const { return _local_addr; }
   std::optional<IPAddr> remote_addr() const { return _remote_addr; }
   IPProto protocol() const { return _protocol; }
+  bool is_connected() const { return connected; }
 
-  virtual void deliver(const PBuf&) = 0;
+  /// Payloads of up to this many bytes are copied into the sent packets
+  /// (summing them for the checksum on the way, see [PBufPool::copy]) instead
+  /// of being referenced by them.
+  size_t copy_threshold = 256;
+
+  virtual void deliver(PBuf) = 0;
   virtual void listen(std::optional<IPAddr> local_addr = std::nullopt, uint16_t local_port = 0);
   virtual void connect(IPAddr remote_addr, uint16_t remote_port, std::optional<IPAddr> local_addr = std::nullopt, uint16_t local_port = 0);
 protected:
   Socket(IPStack &ip_stack) : ip_stack(ip_stack) {}
   void send_pbuf(PBuf, std::optional<IPAddr> = std::nullopt);
+  /// Allocate a packet for sending `payload`, with room for the headers. The
+  /// payload is copied if it is not larger than [copy_threshold], unless
+  /// `may_copy` is false (e.g. for caller-owned memory sent without copying).
+  PBuf alloc_pbuf(const Buf &payload, bool may_copy = true);
 
   IPStack &ip_stack;
   IPProto _protocol;
@@ -79,7 +89,9 @@ public:
     sock->connected = true;
   }
 
-  void deliver(PBuf packet) {
+  /// Find the socket the `packet` is destined to, preferring the connected
+  /// sockets over the listening ones. Returns nullptr if there is none.
+  Socket *find(const PBuf &packet) const {
     IPAddr src_addr = packet->ip().src_addr();
     IPAddr dst_addr = packet->ip().dst_addr();
     IPProto proto;
@@ -92,16 +104,18 @@ public:
 
     auto conn_it =
         connected.find({proto, dst_addr, dst_port, src_addr, src_port});
-    if (conn_it != connected.end()) {
-      conn_it->second->deliver(std::move(packet));
-      return;
-    }
+    if (conn_it != connected.end())
+      return conn_it->second;
 
     auto listen_it = listening.find({proto, dst_addr, dst_port});
-    if (listen_it != listening.end()) {
-      listen_it->second->deliver(std::move(packet));
-      return;
-    }
+    if (listen_it != listening.end())
+      return listen_it->second;
+    return nullptr;
+  }
+
+  void deliver(PBuf packet) {
+    if (Socket *sock = find(packet))
+      sock->deliver(std::move(packet));
   }
 
   void remove(Socket *sock) {
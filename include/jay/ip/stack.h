@@ -5,6 +5,7 @@
 #include "jay/ip/router.h"
 #include "jay/ip/sock.h"
 #include "jay/pbuf.h"
+#include "jay/pbuf_pool.h"
 #include "jay/util/hashtable.h"
 #include "jay/util/time.h"
 #include "jay/udp/udp_sock.h"
@@ -22,7 +23,12 @@ public:
       : stack(stack), _sock_table(std::bind(&IPStack::select_src_addr, this,
                                             std::placeholders::_1, nullptr)) {}
   void ip_input(PBuf, IPVersion);
+  /// Process a burst of received packets of the same IP version, consuming
+  /// them.
+  void ip_input(std::span<PBuf>, IPVersion);
   void arp_input(PBuf);
+  /// Process a burst of received ARP packets, consuming them.
+  void arp_input(std::span<PBuf>);
   void output(PBuf);
 
   void setup_interface(Interface *);
@@ -34,6 +40,7 @@ public:
   void poll();
   SocketTable &sock_table() { return _sock_table; }
   IPRouter &router() { return _router; }
+  PBufPool &pool();
   udp::UDPSocket udp_sock() {
     return {*this};
   }
@@ -47,6 +54,9 @@ private:
   void ip_output_resolve(PBuf);
   void ip_output_fragment(PBuf, size_t if_mtu);
   void ip_output_final(PBuf);
+  /// Deliver a packet sent to a local address directly to its protocol,
+  /// without computing its checksums or parsing its headers again.
+  void ip_loopback(PBuf);
 
   void ip_deliver(PBuf, IPProto);
   void udp_deliver(PBuf);
@@ -88,9 +98,12 @@ private:
   struct Reassembly {
     PBuf packet;
     std::unique_ptr<Timer> timer;
+    /// bytes of the fragments charged to the [MemAccounting]
+    size_t charged_bytes = 0;
   };
   hash_table<ReassKey, Reassembly> reass_queue;
   void reassemble_timeout(ReassKey, Reassembly &);
+  void reassemble_drop(ReassKey);
 
   IPRouter _router;
   Stack &stack;
@@ -96,7 +96,10 @@ public:
   STRUCT_FIELD(dst_addr, 16, IPv4Addr);
   STRUCT_VARARRAY(options, 20, IPv4Option);
 public:
-  static Result<IPv4Header, ErrorType> read(StructWriter cur);
+  /// Read the header at `cur`, verifying its checksum unless `verify_csum` is
+  /// false (e.g. if the device has already verified it).
+  static Result<IPv4Header, ErrorType> read(StructWriter cur,
+                                            bool verify_csum = true);
   static size_t size_hint(size_t opts_size);
   static size_t size_hint(IPHeader& base_hdr, IPFragData* = nullptr);
   static size_t size_hint(IPProto, IPRAOption* = nullptr);
@@ -0,0 +1,190 @@
+#pragma once
+
+#include "jay/buf/mem_resource.h"
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+
+namespace jay {
+/// The parts of the stack holding packets or state on behalf of remote peers,
+/// whose memory is accounted by [MemAccounting].
+enum class MemSubsystem : uint8_t {
+  /// fragments held by incomplete reassemblies (one entry per reassembly)
+  REASSEMBLY,
+  /// packets queued waiting for neighbour resolution (one entry per packet)
+  NEIGH_QUEUE,
+  /// entries of the destination cache of the [ip::IPRouter]
+  DST_CACHE,
+  /// datagrams being delivered to sockets (one entry per datagram). The
+  /// delivery is synchronous and the charge is released right after it, so
+  /// this only gates the datagrams by their [MemPriority] -- its budget never
+  /// binds. The data retained by the application afterwards (e.g. from
+  /// [udp::UDPSocket::on_data_owned_fn]) is covered by the pressure, through
+  /// the attached [PacketMemoryResource], instead.
+  SOCKET,
+};
+
+/// How strongly the stack is short on memory, as signalled by
+/// [MemAccounting::pressure].
+enum class MemPressure : uint8_t { NONE, LOW, HIGH };
+
+/// How valuable the work a charge is made for is. Under memory pressure the
+/// least valuable work is refused first: [SPECULATIVE] work from [LOW]
+/// pressure on, [NEW_FLOW] work at [HIGH] pressure. [ESTABLISHED] work is only
+/// ever refused by the budget of its subsystem.
+enum class MemPriority : uint8_t {
+  /// work that may never complete, e.g. new reassemblies or packets waiting
+  /// for an unresolved neighbour
+  SPECULATIVE,
+  /// work for flows not yet established, e.g. continued reassemblies or
+  /// datagrams for listening sockets
+  NEW_FLOW,
+  /// work for established flows, e.g. datagrams for connected sockets
+  ESTABLISHED,
+};
+
+/// Limits on the memory held by a single [MemSubsystem].
+struct MemBudget {
+  size_t max_bytes = std::numeric_limits<size_t>::max();
+  size_t max_entries = std::numeric_limits<size_t>::max();
+};
+
+/// Byte and entry accounting of the memory held by the subsystems of the
+/// stack, with per-subsystem budgets and a stack-wide pressure signal.
+///
+/// The subsystems [charge] the accounting before taking on more memory and
+/// [release] it once the memory is freed. A charge is refused when it would
+/// exceed the budget of the subsystem or when the current [pressure] sheds
+/// work of its [MemPriority], in which case the subsystem drops the work.
+///
+/// The pressure is derived from the larger of the total accounted bytes and
+/// the bytes in use in the attached [PacketMemoryResource] (which also covers
+/// the packets retained by the application), compared to the watermarks.
+class MemAccounting {
+public:
+  struct Options {
+    /// bytes in use from which [MemPressure::LOW] is signalled
+    size_t low_watermark = 32 << 20;
+    /// bytes in use from which [MemPressure::HIGH] is signalled
+    size_t high_watermark = 64 << 20;
+    std::array<MemBudget, 4> budgets = {
+        MemBudget{.max_bytes = 4 << 20, .max_entries = 256},
+        MemBudget{.max_bytes = 1 << 20, .max_entries = 1024},
+        MemBudget{.max_entries = 4096},
+        MemBudget{},
+    };
+  };
+
+  struct Counters {
+    /// bytes currently charged
+    size_t bytes = 0;
+    /// entries currently charged
+    size_t entries = 0;
+    /// highest number of bytes charged at once
+    size_t peak_bytes = 0;
+    /// number of charges admitted
+    size_t admitted = 0;
+    /// number of charges refused due to the budget of the subsystem
+    size_t over_budget = 0;
+    /// number of charges refused due to memory pressure
+    size_t shed = 0;
+  };
+
+  MemAccounting() : MemAccounting(Options{}) {}
+  explicit MemAccounting(Options opts,
+                         const PacketMemoryResource *resource = nullptr)
+      : opts(opts), resource(resource) {}
+  MemAccounting(const MemAccounting &) = delete;
+  MemAccounting &operator=(const MemAccounting &) = delete;
+
+  /// Charge `bytes` and `entries` to `subsystem`. Returns false (charging
+  /// nothing) if the charge is refused.
+  [[nodiscard]] bool charge(MemSubsystem subsystem, size_t bytes,
+                            MemPriority priority, size_t entries = 1) {
+    Counters &ctrs = counters(subsystem);
+    const MemBudget &budget = opts.budgets[index(subsystem)];
+    if ((ctrs.bytes + bytes > budget.max_bytes) ||
+        (ctrs.entries + entries > budget.max_entries)) {
+      ctrs.over_budget += 1;
+      return false;
+    }
+    if (sheds(priority)) {
+      ctrs.shed += 1;
+      return false;
+    }
+
+    ctrs.bytes += bytes;
+    ctrs.entries += entries;
+    ctrs.peak_bytes = std::max(ctrs.peak_bytes, ctrs.bytes);
+    ctrs.admitted += 1;
+    _total_bytes += bytes;
+    return true;
+  }
+
+  /// Release `bytes` and `entries` previously charged to `subsystem`.
+  void release(MemSubsystem subsystem, size_t bytes, size_t entries = 1) {
+    Counters &ctrs = counters(subsystem);
+    ctrs.bytes -= bytes;
+    ctrs.entries -= entries;
+    _total_bytes -= bytes;
+  }
+
+  /// Return the current memory pressure.
+  MemPressure pressure() const {
+    size_t in_use = _total_bytes;
+    if (resource)
+      in_use = std::max(in_use, resource->bytes_in_use());
+    if (in_use >= opts.high_watermark)
+      return MemPressure::HIGH;
+    if (in_use >= opts.low_watermark)
+      return MemPressure::LOW;
+    return MemPressure::NONE;
+  }
+
+  /// Return whether work of `priority` is currently refused due to memory
+  /// pressure.
+  bool sheds(MemPriority priority) const {
+    switch (pressure()) {
+    case MemPressure::HIGH:
+      return priority != MemPriority::ESTABLISHED;
+    case MemPressure::LOW:
+      return priority == MemPriority::SPECULATIVE;
+    case MemPressure::NONE:
+      break;
+    }
+    return false;
+  }
+
+  const MemBudget &budget(MemSubsystem subsystem) const {
+    return opts.budgets[index(subsystem)];
+  }
+  void set_budget(MemSubsystem subsystem, MemBudget budget) {
+    opts.budgets[index(subsystem)] = budget;
+  }
+  void set_watermarks(size_t low, size_t high) {
+    opts.low_watermark = low;
+    opts.high_watermark = high;
+  }
+
+  const Counters &stats(MemSubsystem subsystem) const {
+    return _counters[index(subsystem)];
+  }
+  /// Total number of bytes charged to all the subsystems.
+  size_t total_bytes() const { return _total_bytes; }
+
+private:
+  static constexpr size_t index(MemSubsystem subsystem) {
+    return static_cast<size_t>(subsystem);
+  }
+  Counters &counters(MemSubsystem subsystem) {
+    return _counters[index(subsystem)];
+  }
+
+  Options opts;
+  const PacketMemoryResource *resource;
+  std::array<Counters, 4> _counters{};
+  size_t _total_bytes = 0;
+};
+} // namespace jay
@@ -0,0 +1,89 @@
+#pragma once
+
+#include "jay/if.h"
+#include "jay/util/spsc_ring.h"
+#include <limits>
+#include <memory>
+#include <span>
+
+namespace jay {
+/// An interface exchanging frames with its peer (the other end of a
+/// [MemoryLink] or a [VirtualSwitch]) through in-memory rings.
+///
+/// The transmitted [PBuf]s are moved to the peer's receive ring as they are,
+/// without copying or linearizing them, so the link costs little more than
+/// the stacks on its ends -- which makes it useful for measuring them, or for
+/// testing without a kernel device. A packet keeps belonging to the pool and
+/// memory of the stack that allocated it, which are not thread-safe, so all
+/// the stacks connected by memory links must be polled from the same thread.
+///
+/// As the link can't corrupt the frames, it offloads the checksums (unless
+/// disabled): the transport checksums of the transmitted packets are left
+/// partial and the received packets are reported valid, so that neither end
+/// computes them, unless a received packet is forwarded to an interface which
+/// doesn't offload them (see [PBufStruct::tx_csum_partial]).
+class MemoryPort : public Interface {
+public:
+  using Ring = SpscRing<PBuf>;
+
+  struct Stats {
+    /// frames received
+    size_t rx_packets = 0;
+    /// frames handed to the peer
+    size_t tx_packets = 0;
+    /// frames dropped because the peer's ring was full
+    size_t tx_drops = 0;
+  };
+
+  /// Create a port receiving the frames from `rx` and transmitting to `tx`.
+  MemoryPort(HWAddr hwaddr, uint16_t mtu, std::shared_ptr<Ring> rx,
+             std::shared_ptr<Ring> tx, bool csum_offload = true);
+
+  void enqueue(PBuf packet) override;
+  size_t poll_rx_burst(Stack &stack, std::span<PBuf> packets) override;
+  void poll_tx(Stack &) override {}
+
+  HWAddr addr() const noexcept override { return _hwaddr; }
+  uint16_t mtu() const noexcept override { return _mtu; }
+  bool scatter_gather() const noexcept override { return true; }
+  size_t max_segments() const noexcept override {
+    return std::numeric_limits<size_t>::max();
+  }
+  bool rx_csum_offload() const noexcept override { return csum_offload; }
+  bool tx_csum_offload() const noexcept override { return csum_offload; }
+
+  const Stats &stats() const { return _stats; }
+
+private:
+  HWAddr _hwaddr;
+  uint16_t _mtu;
+  std::shared_ptr<Ring> rx;
+  std::shared_ptr<Ring> tx;
+  bool csum_offload;
+  Stats _stats;
+};
+
+/// A point-to-point link between two [MemoryPort]s, each to be added to a
+/// [Stack] of its own.
+class MemoryLink {
+public:
+  struct Options {
+    /// entries of the ring in each direction, a power of two
+    size_t ring_size = 1024;
+    uint16_t mtu = 1500;
+    /// whether the ports offload the checksums (see [MemoryPort])
+    bool csum_offload = true;
+  };
+
+  MemoryLink(HWAddr a_hwaddr, HWAddr b_hwaddr, Options opts);
+  MemoryLink(HWAddr a_hwaddr, HWAddr b_hwaddr)
+      : MemoryLink(a_hwaddr, b_hwaddr, Options{}) {}
+
+  const std::shared_ptr<MemoryPort> &a() const { return _a; }
+  const std::shared_ptr<MemoryPort> &b() const { return _b; }
+
+private:
+  std::shared_ptr<MemoryPort> _a;
+  std::shared_ptr<MemoryPort> _b;
+};
+} // namespace jay
@@ -2,6 +2,7 @@
 #include "jay/util/hashtable.h"
 #include "jay/eth.h"
 #include "jay/ip/common.h"
+#include "jay/mem_accounting.h"
 #include "jay/util/time.h"
 #include <list>
 #include <memory>
@@ -18,6 +19,8 @@ struct Neighbour {
   bool router;
 
   std::list<PBuf> queue;
+  /// bytes of the queued packets charged to the [MemAccounting]
+  size_t queued_bytes = 0;
   std::unique_ptr<Timer> timer = nullptr;
   uint8_t retry_ctr;
 };
@@ -36,6 +39,9 @@ public:
   clock::duration delay_timeout = std::chrono::seconds{3};
   clock::duration retrans_timeout = std::chrono::seconds{1};
   uint8_t max_query_retries = 3;
+  /// maximum number of packets queued per unresolved neighbour; the oldest
+  /// packet is dropped when exceeded
+  size_t max_queue_len = 3;
 
   [[nodiscard]] std::optional<PBuf> resolve(PBuf);
   [[nodiscard]] std::optional<std::list<PBuf>>
@@ -55,14 +61,23 @@ public:
     this->unreachable_fn = unreachable_fn;
   }
 
+  /// Account the packets queued for unresolved neighbours to `accounting`.
+  void set_accounting(MemAccounting *accounting) {
+    this->accounting = accounting;
+  }
+
 private:
   void start_solicit(Interface *iface, ip::IPAddr tgt_iaddr,
                      ip::IPAddr siaddr,
                      std::optional<HWAddr> thaddr_hint);
+  void enqueue(Neighbour &, PBuf);
+  void release_queue(Neighbour &);
+
   hash_table<ip::IPAddr, Neighbour> cache;
   std::function<void(Interface *, ip::IPAddr, std::optional<HWAddr>,
                      ip::IPAddr)>
       solicit_fn;
   std::function<void(ip::IPAddr, Neighbour &)> unreachable_fn;
+  MemAccounting *accounting = nullptr;
 };
 } // namespace jay
@@ -9,67 +9,146 @@
 #include "jay/ip/v4.h"
 #include "jay/udp/udp_hdr.h"
 #include <cassert>
+#include <cstring>
 #include <endian.h>
-#include <variant>
+#include <type_traits>
 
 namespace jay {
-struct NoHdr : public std::monostate, public BufStruct<NoHdr> {
-  using BufStruct::BufStruct;
-  NoHdr() : BufStruct<NoHdr>(StructWriter({})) {}
-  size_t size() const { return 0; }
-  friend std::ostream &operator<<(std::ostream &os, const NoHdr &) {
-    os << "no header";
-    return os;
-  }
-};
+/// The kind of the link-layer header of a packet.
+enum class LinkHdrKind : uint8_t { NONE, ETH };
+/// The kind of the network-layer header of a packet.
+enum class NetHdrKind : uint8_t { NONE, ARP, IPV4, IPV6 };
+/// The kind of the transport-layer header of a packet.
+enum class TsptHdrKind : uint8_t { NONE, ICMPV4, ICMPV6, UDP, IGMP };
 
-#define _CONSTRUCT_HDR_FN(name)  template<typename THdr, typename ...CArgT>\
-  requires IsVariantAlternative<THdr, decltype(name)>::value\
-  Result<THdr, typename THdr::ErrorType> construct_ ## name (CArgT&& ...constr_args) {\
+inline LinkHdrKind hdr_kind(const EthHeader &) { return LinkHdrKind::ETH; }
+inline NetHdrKind hdr_kind(const ip::ARPHeader &) { return NetHdrKind::ARP; }
+inline NetHdrKind hdr_kind(const ip::IPHeader &hdr) {
+  return hdr.is_v4() ? NetHdrKind::IPV4 : NetHdrKind::IPV6;
+}
+inline TsptHdrKind hdr_kind(const ip::ICMPHeader &hdr) {
+  return hdr.is_v4() ? TsptHdrKind::ICMPV4 : TsptHdrKind::ICMPV6;
+}
+inline TsptHdrKind hdr_kind(const udp::UDPHeader &) { return TsptHdrKind::UDP; }
+inline TsptHdrKind hdr_kind(const ip::IGMPHeader &) { return TsptHdrKind::IGMP; }
+
+// Headers are written into a private chunk: if the room before the masked
+// position is missing or shared with other buffers (e.g. a payload sent to
+// several destinations), [headroom] bytes are reserved in a new chunk first.
+#define _CONSTRUCT_HDR_FN(layer)  template<typename THdr, typename ...CArgT>\
+  requires std::is_same_v<decltype(hdr_kind(std::declval<const THdr &>())), decltype(layer ## _kind)>\
+  Result<THdr, typename THdr::ErrorType> construct_ ## layer ## _hdr (CArgT&& ...constr_args) {\
     size_t size_hint = THdr::size_hint(std::forward<CArgT>(constr_args)...);\
+    if (!has_room_before(size_hint))\
+      reserve_room(std::max<size_t>(size_hint, headroom));\
     unmask(size_hint);\
     StructWriter writer(begin().contiguous().subspan(0, size_hint));\
     auto hdr_res = THdr::construct(writer, std::forward<CArgT>(constr_args)...);\
+    if (hdr_res.has_value()) {\
+      layer ## _kind = hdr_kind(hdr_res.value());\
+      layer ## _off = masked_size();\
+    }\
     mask(size_hint);\
-    if (hdr_res.has_value())\
-      name = hdr_res.value();\
     return hdr_res;\
   }
 
-#define _READ_HDR_FN(name) template<typename THdr, typename ...RArgT>\
-  requires IsVariantAlternative<THdr, decltype(name)>::value\
-  Result<THdr, typename THdr::ErrorType> read_ ## name (RArgT&&... read_args) {\
+#define _READ_HDR_FN(layer) template<typename THdr, typename ...RArgT>\
+  requires std::is_same_v<decltype(hdr_kind(std::declval<const THdr &>())), decltype(layer ## _kind)>\
+  Result<THdr, typename THdr::ErrorType> read_ ## layer ## _hdr (RArgT&&... read_args) {\
     StructWriter writer(begin().contiguous());\
     Result<THdr, typename THdr::ErrorType> hdr_res = THdr::read(writer, std::forward<RArgT>(read_args)...);\
     if (hdr_res.has_value()) {\
-      name = hdr_res.value();\
+      layer ## _kind = hdr_kind(hdr_res.value());\
+      layer ## _off = masked_size();\
       mask(hdr_res.value().size());\
     }\
     return hdr_res;\
   }
 
 class Interface;
+
+/// The room reserved before the payload of newly allocated packets.
+struct PBufRoom {
+  static constexpr size_t DEFAULT_HEADROOM = 128;
+
+  /// bytes reserved before the payload for the headers prepended on output
+  size_t headroom = DEFAULT_HEADROOM;
+};
+
+/// A packet: the packet data together with its metadata.
+///
+/// The metadata is kept compact (within a cache line) -- instead of the parsed
+/// header objects, only the kinds of the headers and their offsets from the
+/// start of the buffer (including the masked part) are stored. The header
+/// accessors ([eth], [ip], [udp], ...) create views of the headers from these
+/// on each call.
 class PBufStruct : public Buf {
 public:
   using Buf::Buf;
+  /// the default number of bytes reserved before the payload for the packet
+  /// headers
+  static constexpr size_t HEADROOM = PBufRoom::DEFAULT_HEADROOM;
 
   Interface *iface = nullptr;
   std::optional<ip::IPAddr> nh_iaddr;
   std::optional<HWAddr> nh_haddr;
 
-  bool local = false;
-  bool forwarded = false;
-  bool router_alert = false;
-  bool force_source_ip = true;
+  /// the number of bytes [reserve_headers] makes available before the payload
+  uint16_t headroom = HEADROOM;
+  /// the partial internet checksum (see [csum_partial]) of the data following
+  /// the transport header, folded to 16 bits -- recorded when the payload is
+  /// copied into the packet (see [PBufPool::copy]), so that the transport
+  /// checksum can be finished on output without reading the payload again.
+  /// Only meaningful if [payload_csum_valid] is set.
+  uint16_t payload_csum = 0;
+  /// for packets with [tx_csum_partial] set: the offset of the transport
+  /// header from the start of the frame, from which the device sums the rest
+  /// of the frame, and the offset of its checksum field from the header
+  uint16_t csum_start = 0;
+  uint16_t csum_offset = 0;
+  /// for UDP packets exceeding the MTU which are left to the interface to
+  /// fragment (see [Interface::gso_max_size]): the payload size of each
+  /// fragment, or 0 for packets to be transmitted as they are. [csum_start] is
+  /// set for such packets as well.
+  uint16_t gso_size = 0;
 
-  bool has_last_fragment = false;
+private:
+  uint32_t link_off = 0;
+  uint32_t net_off = 0;
+  uint32_t tspt_off = 0;
+  LinkHdrKind link_kind = LinkHdrKind::NONE;
+  NetHdrKind net_kind = NetHdrKind::NONE;
+  TsptHdrKind tspt_kind = TsptHdrKind::NONE;
 
-  std::variant<NoHdr, EthHeader> link_hdr;
-  std::variant<NoHdr, ip::ARPHeader, ip::IPHeader> net_hdr;
-  std::variant<NoHdr, ip::ICMPHeader, udp::UDPHeader, ip::IGMPHeader> tspt_hdr;
-  
-  PBufStruct(size_t payload_size) : Buf(payload_size + 128) {
-    mask(128);
+public:
+  bool local : 1 = false;
+  bool forwarded : 1 = false;
+  bool router_alert : 1 = false;
+  bool force_source_ip : 1 = true;
+  bool has_last_fragment : 1 = false;
+  /// the transport header checksum has already been updated for the outgoing
+  /// packet (e.g. incrementally), so it is not recomputed on output
+  bool tspt_csum_valid : 1 = false;
+  /// [payload_csum] is up to date with the payload
+  bool payload_csum_valid : 1 = false;
+  /// the received packet's checksums need not be verified by the stack (see
+  /// [Interface::rx_csum_offload]): either the device has verified them, or
+  /// the packet comes from a local peer which left its transport checksum
+  /// partial, in which case [tx_csum_partial] is set as well
+  bool rx_csum_valid : 1 = false;
+  /// the transport checksum of the packet is partial: the checksum field holds
+  /// the folded pseudo-header sum, to which the data from [csum_start] on is
+  /// yet to be added, storing the result at [csum_offset]. Outgoing packets
+  /// leave it to the device (see [Interface::tx_csum_offload]); received ones
+  /// (see [rx_csum_valid]) are completed on output if the device can't.
+  bool tx_csum_partial : 1 = false;
+
+  PBufStruct(size_t payload_size, const allocator_type &alloc = {})
+      : PBufStruct(payload_size, PBufRoom{}, alloc) {}
+  PBufStruct(size_t payload_size, PBufRoom room,
+             const allocator_type &alloc = {})
+      : Buf(room.headroom + payload_size, alloc), headroom(room.headroom) {
+    mask(headroom);
   }
 
   PBufStruct(const Buf& buf) : Buf(buf) {}
@@ -79,22 +158,88 @@ public:
   }
 
   void reserve_headers() {
-    reserve_before(128);
+    reserve_room(headroom);
+  }
+
+  /// Reset the packet metadata and the parsed headers, keeping the interface
+  /// and the buffer itself. Used when reusing a received packet for a reply.
+  void reset_metadata() {
+    nh_iaddr.reset();
+    nh_haddr.reset();
+    local = false;
+    forwarded = false;
+    router_alert = false;
+    force_source_ip = true;
+    has_last_fragment = false;
+    tspt_csum_valid = false;
+    payload_csum_valid = false;
+    rx_csum_valid = false;
+    tx_csum_partial = false;
+    gso_size = 0;
+    reset_headers();
+  }
+
+  /// Copy the unmasked part of the packet into a single chunk, unless it
+  /// already is contiguous. The parsed headers are reset, as they may point
+  /// into the replaced chunks.
+  void linearize() {
+    if (is_contiguous())
+      return;
+    buf() = as_contiguous();
+    reset_headers();
+  }
+
+  /// Make the headers from the network-layer one up to the masked position
+  /// writable, copying them if they are shared with other buffers (e.g. with
+  /// the other packets of a received block or a replayed capture), so that
+  /// they can be rewritten in place.
+  void unshare_net_hdr() { unshare_before(masked_size() - net_off); }
+
+  /// Compute the checksum of the unmasked data, which starts with a transport
+  /// header of `hdr_size` bytes, adding it to `init_sum` (e.g. the pseudo-header
+  /// sum). The data after the header is not read if [payload_csum] is valid.
+  uint16_t tspt_csum(size_t hdr_size, uint32_t init_sum = 0) {
+    if (!payload_csum_valid)
+      return ip::inet_csum(buf(), init_sum);
+    assert(hdr_size % 2 == 0);
+    std::span<const uint8_t> hdr = begin().contiguous().subspan(0, hdr_size);
+    return ~csum_fold(csum_partial(hdr, init_sum) + payload_csum);
+  }
+
+  /// Complete the partial transport checksum (see [tx_csum_partial]) of a
+  /// received packet, whose network-layer header is masked, as its device
+  /// would have. The checksum field is copied first if it is shared with
+  /// other buffers.
+  void complete_tx_csum() {
+    // [csum_start] counts from the start of the Ethernet frame
+    size_t tspt_off = csum_start - EthHeader::SIZE - (masked_size() - net_off);
+    mask(tspt_off);
+    uint16_t csum = ip::inet_csum(buf());
+    // a zero sum is sent as all ones, which UDP doesn't take for no checksum
+    if (csum == 0)
+      csum = 0xffff;
+    size_t field_end = csum_offset + sizeof(csum);
+    mask(field_end);
+    unshare_before(sizeof(csum));
+    unmask(sizeof(csum));
+    std::memcpy(begin().contiguous().data(), &csum, sizeof(csum));
+    unmask(tspt_off + csum_offset);
+    tx_csum_partial = false;
   }
 
   /// Construct a link-layer header before the masked position. The resulting header is not unmasked.
-  _CONSTRUCT_HDR_FN(link_hdr)
+  _CONSTRUCT_HDR_FN(link)
   /// Construct a network-layer header before the masked position. The resulting header is not unmasked.
-  _CONSTRUCT_HDR_FN(net_hdr)
+  _CONSTRUCT_HDR_FN(net)
   /// Construct a transport-layer header before the masked position. The resulting header is not unmasked.
-  _CONSTRUCT_HDR_FN(tspt_hdr)
+  _CONSTRUCT_HDR_FN(tspt)
 
   /// Read a link-layer header at the masked position. The resulting header data is masked.
-  _READ_HDR_FN(link_hdr)
+  _READ_HDR_FN(link)
   /// Read a network-layer header at the masked position. The resulting header data is masked.
-  _READ_HDR_FN(net_hdr)
+  _READ_HDR_FN(net)
   /// Read a transport-layer header at the masked position. The resulting header data is masked.
-  _READ_HDR_FN(tspt_hdr)
+  _READ_HDR_FN(tspt)
 
   Buf& buf() {
     return *this;
@@ -103,30 +248,76 @@ public:
   Result<Buf::iterator, Buf::InsertError> insert(PBufStruct& other, size_t offset, size_t length = std::dynamic_extent) {
     return Buf::insert(other, offset, length);
   }
-  
-  bool is_ip() { return std::holds_alternative<ip::IPHeader>(net_hdr); }
-  bool is_arp() { return std::holds_alternative<ip::ARPHeader>(net_hdr); }
-  bool is_igmp() { return std::holds_alternative<ip::IGMPHeader>(tspt_hdr); }
-  bool is_icmp() { return std::holds_alternative<ip::ICMPHeader>(tspt_hdr); }
-  bool is_udp() { return std::holds_alternative<udp::UDPHeader>(tspt_hdr); }
-
-  EthHeader& eth() { return std::get<EthHeader>(link_hdr); }
-  ip::IPHeader& ip() { return std::get<ip::IPHeader>(net_hdr); }
-  ip::ARPHeader& arp() { return std::get<ip::ARPHeader>(net_hdr); }
-  ip::IGMPHeader& igmp() { return std::get<ip::IGMPHeader>(tspt_hdr); }
-  ip::ICMPHeader& icmp() { return std::get<ip::ICMPHeader>(tspt_hdr); }
-  udp::UDPHeader& udp() { return std::get<udp::UDPHeader>(tspt_hdr); }
+
+  bool is_eth() const { return link_kind == LinkHdrKind::ETH; }
+  bool is_ip() const {
+    return (net_kind == NetHdrKind::IPV4) || (net_kind == NetHdrKind::IPV6);
+  }
+  bool is_arp() const { return net_kind == NetHdrKind::ARP; }
+  bool is_igmp() const { return tspt_kind == TsptHdrKind::IGMP; }
+  bool is_icmp() const {
+    return (tspt_kind == TsptHdrKind::ICMPV4) ||
+           (tspt_kind == TsptHdrKind::ICMPV6);
+  }
+  bool is_udp() const { return tspt_kind == TsptHdrKind::UDP; }
+
+  EthHeader eth() {
+    assert(is_eth());
+    return EthHeader::view(hdr_cursor(link_off));
+  }
+  ip::IPHeader ip() {
+    assert(is_ip());
+    if (net_kind == NetHdrKind::IPV4)
+      return ip::IPv4Header::view(hdr_cursor(net_off));
+    return ip::IPv6Header::view(hdr_cursor(net_off));
+  }
+  ip::ARPHeader arp() {
+    assert(is_arp());
+    return ip::ARPHeader::view(hdr_cursor(net_off));
+  }
+  ip::IGMPHeader igmp() {
+    assert(is_igmp());
+    return ip::IGMPHeader::view(hdr_cursor(tspt_off));
+  }
+  ip::ICMPHeader icmp() {
+    assert(is_icmp());
+    return ip::ICMPHeader::view(hdr_cursor(tspt_off),
+                                (tspt_kind == TsptHdrKind::ICMPV4)
+                                    ? ip::IPVersion::V4
+                                    : ip::IPVersion::V6);
+  }
+  udp::UDPHeader udp() {
+    assert(is_udp());
+    return udp::UDPHeader::view(hdr_cursor(tspt_off));
+  }
 
   friend std::ostream &operator<<(std::ostream &os, PBufStruct &addr) {
     os << "Packet (unmasked size=" << addr.size() << ")\n";
     os << "Link: ";
-    std::visit([&](const auto& hdr) { os << hdr; }, addr.link_hdr);
+    if (addr.is_eth())
+      os << addr.eth();
+    else
+      os << "no header";
     os << "\n";
     os << "Network: ";
-    std::visit([&](const auto& hdr) { os << hdr; }, addr.net_hdr);
+    if (addr.is_ip())
+      os << addr.ip();
+    else if (addr.is_arp())
+      os << addr.arp();
+    else
+      os << "no header";
     os << "\n";
     os << "Transport: ";
-    std::visit([&](auto& hdr) { os << hdr; }, addr.tspt_hdr);
+    if (addr.is_icmp()) {
+      ip::ICMPHeader icmp_hdr = addr.icmp();
+      os << icmp_hdr;
+    } else if (addr.is_udp()) {
+      os << addr.udp();
+    } else if (addr.is_igmp()) {
+      os << addr.igmp();
+    } else {
+      os << "no header";
+    }
     os << "\n";
     os << "Unmasked data: \n";
     size_t rem_line = 15;
@@ -142,18 +333,54 @@ public:
     os << "\n";
     return os;
   }
+
+private:
+  /// Return a cursor over the contiguous data at `buf_offset`.
+  StructWriter hdr_cursor(size_t buf_offset) {
+    return StructWriter(at(buf_offset).contiguous());
+  }
+
+  void reset_headers() {
+    link_kind = LinkHdrKind::NONE;
+    net_kind = NetHdrKind::NONE;
+    tspt_kind = TsptHdrKind::NONE;
+  }
+
+  /// Like [reserve_before], shifting the offsets of the headers after the
+  /// masked position by the bytes added before it.
+  void reserve_room(size_t res_size) {
+    size_t old_masked = masked_size();
+    reserve_before(res_size);
+    uint32_t shift = masked_size() - old_masked;
+    for (uint32_t *off : {&link_off, &net_off, &tspt_off}) {
+      if (*off >= old_masked)
+        *off += shift;
+    }
+  }
 };
 
-class PBuf : public std::unique_ptr<PBufStruct> {
-  using std::unique_ptr<PBufStruct>::unique_ptr;
+class PBufPool;
+/// Deleter of [PBuf]. Packets originating from a [PBufPool] are returned to
+/// it, others are freed.
+struct PBufDeleter {
+  PBufPool *pool = nullptr;
+  void operator()(PBufStruct *) const;
+};
+
+class PBuf : public std::unique_ptr<PBufStruct, PBufDeleter> {
+  using std::unique_ptr<PBufStruct, PBufDeleter>::unique_ptr;
+  friend class PBufPool;
+
+  PBuf(PBufStruct *packet, PBufPool *pool)
+      : std::unique_ptr<PBufStruct, PBufDeleter>(packet, PBufDeleter{pool}) {}
 public:
-  PBuf() : std::unique_ptr<PBufStruct>(std::make_unique<PBufStruct>()) {};
+  PBuf() : std::unique_ptr<PBufStruct, PBufDeleter>(new PBufStruct()) {};
   template<typename ...T>
-  PBuf(T&&... args) : std::unique_ptr<PBufStruct>(std::make_unique<PBufStruct>(std::forward<T>(args)...)) {}
+  requires std::is_constructible_v<PBufStruct, T...>
+  PBuf(T&&... args) : std::unique_ptr<PBufStruct, PBufDeleter>(new PBufStruct(std::forward<T>(args)...)) {}
   
   template<typename TMsg, typename TCode = uint8_t>
-  static PBuf icmp_for(ip::IPAddr dst_addr, TMsg* msg = nullptr, TCode code = 0, Buf* payload = nullptr, std::optional<uint16_t> router_alert = std::nullopt) {
-    PBuf packet;
+  static PBuf icmp_for(PBuf packet, ip::IPAddr dst_addr, TMsg* msg = nullptr, TCode code = 0, Buf* payload = nullptr, std::optional<uint16_t> router_alert = std::nullopt) {
     packet->reserve_headers();
     if (payload) {
       packet->buf().insert(*payload, 0);
@@ -0,0 +1,111 @@
+#pragma once
+#include "jay/buf/sbuf.h"
+#include "jay/pbuf.h"
+#include <memory_resource>
+#include <stdexcept>
+#include <vector>
+
+namespace jay {
+/// A recycling pool of [PBufStruct] instances.
+///
+/// Each pooled packet owns a backing [BufChunk] of `chunk_size` bytes, which is
+/// used for the headroom and (if it fits) the payload of the packets handed
+/// out by [get]. The pool's reference to the backing chunk is pinned (see
+/// [BufChunk::pin]), so that the packets can write their headers into it.
+/// Packets are returned to the pool by the [PBuf] deleter and
+/// reused without further allocation, unless their backing chunk is still
+/// referenced from elsewhere (e.g. by a [Buf] copy held by an application), in
+/// which case a new backing chunk is allocated.
+///
+/// The backing chunks (as well as the non-pooled packets) are allocated from
+/// the memory resource supplied at construction.
+///
+/// The pool is not thread-safe and must outlive all the packets it hands out.
+class PBufPool {
+public:
+  static constexpr size_t DEFAULT_CHUNK_SIZE = 2048;
+  static constexpr size_t DEFAULT_CAPACITY = 256;
+
+  struct Stats {
+    /// packets served from the pool
+    size_t hits = 0;
+    /// packets that had to be allocated
+    size_t misses = 0;
+    /// returned packets whose backing chunk had to be replaced
+    size_t escaped = 0;
+  };
+
+  explicit PBufPool(
+      size_t chunk_size = DEFAULT_CHUNK_SIZE,
+      size_t capacity = DEFAULT_CAPACITY,
+      std::pmr::memory_resource *mem = std::pmr::get_default_resource())
+      : chunk_size(chunk_size), capacity(capacity), mem(mem) {
+    free_list.reserve(capacity);
+  }
+  PBufPool(const PBufPool &) = delete;
+  PBufPool &operator=(const PBufPool &) = delete;
+  ~PBufPool();
+
+  /// Get a packet with `payload_size` bytes of unmasked payload, preceded by
+  /// the room given by the pool's [PBufRoom] policy. Falls back to a
+  /// non-pooled packet if it doesn't fit into the pooled chunks.
+  PBuf get(size_t payload_size = 0);
+
+  /// Get a packet wrapping (without copying) `payload`, with headroom for the
+  /// headers reserved before it.
+  PBuf get(const Buf &payload);
+
+  /// Get a packet holding a copy of the unmasked part of `payload` (laid out
+  /// like by [get]), recording its checksum in [PBufStruct::payload_csum]. The
+  /// checksum is computed while copying, so the payload is only read once.
+  PBuf copy(const Buf &payload);
+
+  const PBufRoom &room() const { return _room; }
+  /// Set the room reserved before the payload of the packets handed out from
+  /// now on. The headroom may not exceed the pooled chunk size.
+  void set_room(PBufRoom room) {
+    if (room.headroom > chunk_size)
+      throw std::invalid_argument("headroom larger than the pooled chunks");
+    _room = room;
+  }
+
+  /// Pre-allocate pooled packets, so that up to `count` packets are available
+  /// without allocation.
+  void reserve(size_t count);
+
+  const Stats &stats() const { return _stats; }
+  /// Number of packets currently available in the pool.
+  size_t available() const { return free_list.size(); }
+
+private:
+  friend struct PBufDeleter;
+  struct Entry : public PBufStruct {
+    Entry(size_t chunk_size, std::pmr::memory_resource *mem)
+        : backing(chunk_size, allocator_type(mem)) {
+      backing.pin();
+    }
+    Entry(const Entry &) = delete;
+    Entry &operator=(const Entry &) = delete;
+    ~Entry() { backing.unpin(); }
+
+    /// Replace the backing chunk by a newly allocated one.
+    void replace_backing(size_t chunk_size, std::pmr::memory_resource *mem) {
+      backing.unpin();
+      backing = BufChunk(chunk_size, allocator_type(mem));
+      backing.pin();
+    }
+
+    BufChunk backing;
+  };
+
+  Entry *acquire();
+  void release(PBufStruct *);
+
+  size_t chunk_size;
+  size_t capacity;
+  std::pmr::memory_resource *mem;
+  std::vector<Entry *> free_list;
+  PBufRoom _room;
+  Stats _stats;
+};
+} // namespace jay
@@ -0,0 +1,127 @@
+#pragma once
+
+#include "jay/if.h"
+#include <chrono>
+#include <cstdio>
+#include <span>
+#include <string>
+#include <vector>
+
+namespace jay {
+/// An interface replaying the Ethernet frames of a pcap or pcapng capture to
+/// the stack, and recording the frames the stack transmits to a pcap file.
+///
+/// The capture is mapped to memory once and its frames are handed to the
+/// stack as slices of the mapping, without copying. As the interface keeps
+/// its own reference to the mapping, the slices are never unique, so the
+/// stack copies the headers it rewrites (see [Buf::unshare_before]) instead of
+/// modifying the mapping -- each pass of [Options::loop] thus replays the
+/// pristine frames.
+///
+/// The frames are replayed as fast as the stack polls them, or at their
+/// recorded timing scaled by [Options::speed]. Frames of non-Ethernet
+/// interfaces of a pcapng capture are skipped.
+class PcapInterface : public Interface {
+public:
+  struct Options {
+    /// file to record the transmitted frames to (as pcap with nanosecond
+    /// timestamps), none if empty
+    std::string output_path;
+    /// replay the capture over and over instead of once
+    bool loop = false;
+    /// replay the frames at their recorded timing sped up by this factor, or
+    /// as fast as possible if 0
+    double speed = 0;
+    HWAddr hwaddr{0x02, 0, 0, 0, 0, 0x01};
+    uint16_t mtu = 1500;
+  };
+
+  struct Stats {
+    /// frames replayed and their total size
+    size_t rx_packets = 0;
+    size_t rx_bytes = 0;
+    /// frames transmitted by the stack and their total size
+    size_t tx_packets = 0;
+    size_t tx_bytes = 0;
+    /// passes over the capture started so far
+    size_t passes = 0;
+    /// time from the first poll to the last replayed frame
+    std::chrono::steady_clock::duration elapsed{};
+
+    /// Return the achieved replay rate in frames per second.
+    double packets_per_sec() const { return rate(rx_packets); }
+    /// Return the achieved replay rate in bytes per second.
+    double bytes_per_sec() const { return rate(rx_bytes); }
+
+  private:
+    double rate(size_t count) const {
+      double secs = std::chrono::duration<double>(elapsed).count();
+      return secs > 0 ? double(count) / secs : 0;
+    }
+  };
+
+  /// Open the capture `input_path` and the output file, if any. Throws
+  /// [std::system_error] if a file can't be opened or mapped, and
+  /// [std::invalid_argument] if the capture isn't a pcap or pcapng file or
+  /// a pcap file of a link type other than Ethernet. A capture truncated in
+  /// the middle of a frame is replayed up to that frame.
+  PcapInterface(const std::string &input_path, Options opts);
+  explicit PcapInterface(const std::string &input_path)
+      : PcapInterface(input_path, Options{}) {}
+  PcapInterface(const PcapInterface &) = delete;
+  PcapInterface &operator=(const PcapInterface &) = delete;
+  ~PcapInterface() override;
+
+  void enqueue(PBuf packet) override;
+  size_t poll_rx_burst(Stack &stack, std::span<PBuf> packets) override;
+  void poll_tx(Stack &) override {}
+
+  HWAddr addr() const noexcept override { return opts.hwaddr; }
+  uint16_t mtu() const noexcept override { return opts.mtu; }
+  bool scatter_gather() const noexcept override { return true; }
+  size_t max_segments() const noexcept override { return MAX_SEGMENTS; }
+
+  /// Whether the capture has been replayed completely (never with
+  /// [Options::loop], unless the capture holds no frames). With
+  /// [Options::loop], [poll_rx_burst] returns a short burst at the end of
+  /// each pass, so that [Stack::poll] returns.
+  bool done() const { return _done; }
+  /// Write the buffered records of the output file to it.
+  void flush();
+
+  const Stats &stats() const { return _stats; }
+
+private:
+  static constexpr size_t MAX_SEGMENTS = 16;
+
+  /// A frame of the capture.
+  struct Frame {
+    size_t offset;
+    uint32_t size;
+    /// the capture timestamp in nanoseconds
+    uint64_t ts;
+  };
+
+  void map_file();
+  void index_pcap(std::span<const uint8_t> data);
+  void index_pcapng(std::span<const uint8_t> data);
+  void open_output(const std::string &path);
+
+  Options opts;
+  int fd = -1;
+  size_t file_size = 0;
+  /// the mapping of the whole capture
+  BufChunk mapping;
+  std::vector<Frame> frames;
+  size_t next_frame = 0;
+  std::FILE *output = nullptr;
+
+  bool started = false;
+  bool _done = false;
+  /// whether the current pass has ended with a short burst
+  bool pass_ended = false;
+  std::chrono::steady_clock::time_point start;
+  std::chrono::steady_clock::time_point pass_start;
+  Stats _stats;
+};
+} // namespace jay
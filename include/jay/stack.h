@@ -1,18 +1,63 @@
 #pragma once
 
+#include "jay/buf/mem_resource.h"
 #include "jay/if.h"
+#include "jay/mem_accounting.h"
 #include "jay/ip/stack.h"
+#include "jay/pbuf_pool.h"
 #include <memory>
+#include <span>
 #include <vector>
 namespace jay {
+/// When and how the [Stack] merges small chunks of packets (see
+/// [Buf::compact]).
+struct CompactPolicy {
+  /// chunks smaller than this are merged with their small neighbours
+  size_t threshold = 512;
+  /// only packets consisting of more chunks than this are compacted
+  size_t max_chunks = 4;
+  /// compact the packets before delivering them to sockets
+  bool before_deliver = true;
+  /// compact the packets with more segments than the output interface can
+  /// gather before handing them to it
+  bool before_output = true;
+
+  void apply(Buf &buf) const {
+    if (buf.chunk_count() > max_chunks)
+      buf.compact(threshold);
+  }
+};
+
 class Stack {
 public:
-  Stack() : ip(*this) {};
+  explicit Stack(PacketMemoryResource::Options mem_opts = {},
+                 MemAccounting::Options accounting_opts = {})
+      : mem(mem_opts), accounting(accounting_opts, &mem),
+        pool(PBufPool::DEFAULT_CHUNK_SIZE, PBufPool::DEFAULT_CAPACITY, &mem),
+        ip(*this) {
+    ip.router().set_accounting(&accounting);
+    rx_burst.reserve(RX_BURST);
+    for (size_t i = 0; i < RX_BURST; i++)
+      rx_burst.emplace_back(nullptr);
+  };
   Stack(const Stack &) = delete;
   Stack &operator=(const PBuf &) = delete;
   Stack(Stack &&) = delete;
 
+  /// The maximum number of packets polled from an interface at once (see
+  /// [Interface::poll_rx_burst]).
+  static constexpr size_t RX_BURST = 32;
+
   void input(Interface *iface, PBuf packet);
+  /// Process a burst of packets received on `iface`. The packets are split
+  /// into runs of the same EtherType, each handed to the network layer as a
+  /// whole, and the packets output while processing the burst are handed to
+  /// the interfaces in bursts afterwards (see [Interface::enqueue_burst]).
+  /// The packets are consumed, leaving null [PBuf]s in `packets`.
+  void input_burst(Interface *iface, std::span<PBuf> packets);
+  /// Output a packet with an assigned interface. While a burst is being
+  /// processed, the packet is staged and handed to the interface together
+  /// with the other packets output in the meantime.
   void output(PBuf packet);
   void poll();
 
@@ -20,9 +65,55 @@ public:
   const std::vector<std::shared_ptr<Interface>> &interfaces() const {
     return ifaces;
   }
+
+  /// Set the room reserved before the payload of the packets allocated by the
+  /// stack. The headroom is further extended by the largest
+  /// [Interface::headroom] of the added interfaces.
+  void set_room(PBufRoom room);
+  const PBufRoom &room() const { return base_room; }
+  /// Memory resource backing the packet data allocated by the stack. The
+  /// buffers handed out to the application keep referencing it, so the stack
+  /// must outlive them.
+  PacketMemoryResource mem;
+  /// Accounting of the memory held by the subsystems of the stack, with their
+  /// budgets and the memory pressure signal (see [MemAccounting]).
+  MemAccounting accounting;
+  /// Pool of packet buffers used for received and locally generated packets.
+  /// Declared before the other members so that it outlives the packets queued
+  /// in them.
+  PBufPool pool;
+  CompactPolicy compact_policy;
   ip::IPStack ip;
 
 private:
+  void update_room();
+
+  /// Stages the packets output during its lifetime, handing them to their
+  /// interfaces in bursts at its end (of the outermost one, as they may nest).
+  class OutputBatch {
+  public:
+    explicit OutputBatch(Stack &stack) : stack(stack) { stack.batch_depth++; }
+    OutputBatch(const OutputBatch &) = delete;
+    OutputBatch &operator=(const OutputBatch &) = delete;
+    ~OutputBatch() {
+      if (--stack.batch_depth == 0)
+        stack.flush_output();
+    }
+
+  private:
+    Stack &stack;
+  };
+  void flush_output();
+
   std::vector<std::shared_ptr<Interface>> ifaces;
+  PBufRoom base_room;
+  size_t batch_depth = 0;
+  /// packets output while a batch is open
+  std::vector<PBuf> tx_pending;
+  /// spare storage swapped with [tx_pending] when flushing, so that neither
+  /// allocates in the steady state
+  std::vector<PBuf> tx_spare;
+  /// storage for the packets polled by [Interface::poll_rx_burst]
+  std::vector<PBuf> rx_burst;
 };
 } // namespace jay
@@ -1,17 +1,44 @@
 #pragma once
 #include <functional>
+#include <span>
 #include <stdexcept>
 #include "jay/ip/sock.h"
 namespace jay::udp {
 class UDPSocket : public ip::Socket {
 public:
+  /// Callback releasing caller-owned memory passed to [send].
+  using ReleaseFn = std::function<void(std::span<const uint8_t>)>;
+
   UDPSocket(ip::IPStack& ip_stack) : ip::Socket(ip_stack, ip::IPProto::UDP) {}
 
   void send(const Buf& buf, std::optional<ip::IPAddr> dst_ip = std::nullopt, uint16_t dst_port = 0) {
-    send_pbuf(PBuf(buf, true), dst_ip, dst_port);
+    send_pbuf(alloc_pbuf(buf), dst_ip, dst_port);
+  }
+
+  /// Send `data` without copying it, however small (see [copy_threshold]).
+  /// The memory must stay valid and unchanged until `release(data)` is
+  /// called, which happens once the stack (and the interface transmitting the
+  /// packet) no longer references it -- possibly before this call returns,
+  /// e.g. if the packet is dropped, or copied because the interface can't
+  /// gather its chunks (see [Interface::scatter_gather]).
+  void send(std::span<const uint8_t> data, ReleaseFn release,
+            std::optional<ip::IPAddr> dst_ip = std::nullopt,
+            uint16_t dst_port = 0) {
+    // the stack never writes to the payload chunks of outgoing packets
+    auto *ptr = const_cast<uint8_t *>(data.data());
+    Buf buf(BufChunk(ptr, data.size(), 0,
+                     [data, release = std::move(release)](uint8_t *) {
+                       if (release)
+                         release(data);
+                     }));
+    send_pbuf(alloc_pbuf(buf, false), dst_ip, dst_port);
   }
 
   std::function<void(UDPSocket&, const Buf&, ip::IPAddr, uint16_t)> on_data_fn;
+  /// Like [on_data_fn], but hands the payload of the received datagram over to
+  /// the application, which may keep it without copying. Takes precedence over
+  /// [on_data_fn] when set.
+  std::function<void(UDPSocket&, Buf, ip::IPAddr, uint16_t)> on_data_owned_fn;
 protected:
   void send_pbuf(PBuf packet, std::optional<ip::IPAddr> dst_ip = std::nullopt, uint16_t dst_port = 0) {
     auto udp_hdr = packet->construct_tspt_hdr<UDPHeader>().value();
@@ -30,9 +57,13 @@ protected:
     ip::Socket::send_pbuf(std::move(packet), dst_ip);
   }
 
-  void deliver(const PBuf& packet) override {
-     if (on_data_fn)
-      on_data_fn(*this, packet->buf(), packet->ip().src_addr(), packet->udp().src_port());
+  void deliver(PBuf packet) override {
+    ip::IPAddr src_addr = packet->ip().src_addr();
+    uint16_t src_port = packet->udp().src_port();
+    if (on_data_owned_fn)
+      on_data_owned_fn(*this, std::move(packet->buf()), src_addr, src_port);
+    else if (on_data_fn)
+      on_data_fn(*this, packet->buf(), src_addr, src_port);
   }
 };
 }
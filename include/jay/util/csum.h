@@ -0,0 +1,136 @@
+#pragma once
+
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <span>
+
+namespace jay {
+/// Kernels computing the partial internet checksum (see [csum_partial]).
+enum class CsumImpl : uint8_t { SCALAR, SSE2, AVX2, AVX512 };
+
+/// Return whether the CPU the process runs on supports the kernel `impl`.
+bool csum_supported(CsumImpl impl);
+
+/// Return the kernel selected (through CPUID on x86) for [csum_partial].
+CsumImpl csum_selected();
+
+/// Data up to this size is summed inline by [csum_partial], as it is not worth
+/// the indirect call and the vector setup (e.g. IP headers).
+constexpr size_t CSUM_INLINE_MAX = 64;
+
+/// Add `part` to `sum` in 64-bit ones' complement arithmetic.
+constexpr uint64_t csum_add(uint64_t sum, uint64_t part) {
+  sum += part;
+  return sum + (sum < part);
+}
+
+/// Sum `len` bytes at `data` without vector instructions (see [csum_partial]).
+inline uint64_t csum_words(const uint8_t *data, size_t len) {
+  // 32-bit words are congruent to the sums of their 16-bit halves modulo
+  // 0xffff, so they can be summed directly
+  uint64_t sum = 0;
+  while (len >= 8) {
+    uint64_t word;
+    std::memcpy(&word, data, 8);
+    sum += (word & 0xffffffff) + (word >> 32);
+    data += 8;
+    len -= 8;
+  }
+  if (len >= 4) {
+    uint32_t word;
+    std::memcpy(&word, data, 4);
+    sum += word;
+    data += 4;
+    len -= 4;
+  }
+  if (len >= 2) {
+    uint16_t word;
+    std::memcpy(&word, data, 2);
+    sum += word;
+    data += 2;
+    len -= 2;
+  }
+  if (len) {
+    if constexpr (std::endian::native == std::endian::little)
+      sum += data[0];
+    else
+      sum += uint16_t(data[0]) << 8;
+  }
+  return sum;
+}
+
+/// Like [csum_partial], but always dispatching to the selected kernel.
+uint64_t csum_partial_dispatch(std::span<const uint8_t> data, uint64_t sum);
+
+/// Add the 16-bit words of `data` to the ones' complement sum `sum`. The words
+/// are read in native byte order and an odd trailing byte is padded by a zero
+/// byte, so the result is only meaningful when `data` starts at an even offset
+/// of the checksummed data (see [csum_shift] for the odd case). The sum is
+/// accumulated in 64 bits and may be folded down to 16 bits by [csum_fold].
+inline uint64_t csum_partial(std::span<const uint8_t> data, uint64_t sum = 0) {
+  if (data.size() <= CSUM_INLINE_MAX)
+    return csum_add(sum, csum_words(data.data(), data.size()));
+  return csum_partial_dispatch(data, sum);
+}
+
+/// Like [csum_partial], but using the kernel `impl`, which must be supported.
+uint64_t csum_partial(std::span<const uint8_t> data, uint64_t sum,
+                      CsumImpl impl);
+
+/// Like [csum_copy], but always dispatching to the selected kernel.
+uint64_t csum_copy_dispatch(std::span<const uint8_t> src, uint8_t *dst,
+                            uint64_t sum);
+
+/// Copy `src` to `dst` (which must not overlap it) and add its 16-bit words to
+/// the ones' complement sum `sum` like [csum_partial], loading each byte only
+/// once for both.
+inline uint64_t csum_copy(std::span<const uint8_t> src, uint8_t *dst,
+                          uint64_t sum = 0) {
+  if (src.size() <= CSUM_INLINE_MAX) {
+    if (!src.empty())
+      std::memcpy(dst, src.data(), src.size());
+    return csum_add(sum, csum_words(src.data(), src.size()));
+  }
+  return csum_copy_dispatch(src, dst, sum);
+}
+
+/// Like [csum_copy], but using the kernel `impl`, which must be supported.
+uint64_t csum_copy(std::span<const uint8_t> src, uint8_t *dst, uint64_t sum,
+                   CsumImpl impl);
+
+/// Fold the 64-bit ones' complement sum `sum` down to 16 bits.
+constexpr uint16_t csum_fold(uint64_t sum) {
+  sum = (sum & 0xffffffff) + (sum >> 32);
+  sum = (sum & 0xffffffff) + (sum >> 32);
+  sum = (sum & 0xffff) + (sum >> 16);
+  sum = (sum & 0xffff) + (sum >> 16);
+  return static_cast<uint16_t>(sum);
+}
+
+/// Adjust the partial sum of data starting at an odd offset of the
+/// checksummed data, so that it can be added to the sums of the preceding
+/// data.
+constexpr uint64_t csum_shift(uint64_t sum) {
+  uint16_t folded = csum_fold(sum);
+  return static_cast<uint16_t>((folded << 8) | (folded >> 8));
+}
+
+/// Return the checksum `csum` updated for the covered bytes `old_data` being
+/// replaced by `new_data` of the same size (RFC 1624, eqn. 3), without
+/// summing the rest of the covered data again. `odd` tells whether the bytes
+/// start at an odd offset of the checksummed data.
+inline uint16_t csum_replace(uint16_t csum, std::span<const uint8_t> old_data,
+                             std::span<const uint8_t> new_data,
+                             bool odd = false) {
+  uint64_t old_sum = csum_words(old_data.data(), old_data.size());
+  uint64_t new_sum = csum_words(new_data.data(), new_data.size());
+  if (odd) {
+    old_sum = csum_shift(old_sum);
+    new_sum = csum_shift(new_sum);
+  }
+  uint16_t neg_old = ~csum_fold(old_sum);
+  return ~csum_fold(uint16_t(~csum) + uint64_t(neg_old) + new_sum);
+}
+} // namespace jay
@@ -1,120 +1,100 @@
 #pragma once
 
+#include "jay/util/traits.h"
 #include <algorithm>
 #include <cstddef>
+#include <cstring>
 #include <initializer_list>
-#include <iterator>
+#include <memory>
+#include <new>
 #include <type_traits>
 #include <utility>
-#include <vector>
 
 namespace jay {
-/// A vector class with small-vector optimizations (holds up to `S` in the class
-/// itself and the overflow in a heap-allocated vector).
+/// A vector class with small-vector optimizations.
+///
+/// Up to `S` elements are held in a buffer inside the class itself. When the
+/// vector grows beyond that, all the elements migrate to a single
+/// heap-allocated buffer, so that the elements are always stored contiguously
+/// and the iterators are plain pointers. Elements of [IsTriviallyRelocatable]
+/// types are moved around using `memmove`.
 template <typename T, size_t S> class SmallVec {
+  static constexpr bool RELOCATE_BYTES = IsTriviallyRelocatable_v<T>;
+
 public:
-  explicit SmallVec(size_t size)
-      : _size(size), small_arr{}, overflow_vec(std::max(S, size) - S) {};
+  using value_type = T;
+  using iterator = T *;
+  using const_iterator = const T *;
+
   SmallVec() = default;
-  SmallVec(std::initializer_list<T> init_list) : _size(init_list.size()) {
-    for (auto &&val : init_list) {
-      emplace_back(val);
-    }
+  explicit SmallVec(size_t size) {
+    reserve(size);
+    std::uninitialized_value_construct_n(data_ptr, size);
+    _size = size;
   }
-public:
-  template<typename Ti>
-  struct Iterator {
-    using value_type = Ti;
-    using difference_type = ptrdiff_t;
-    using iterator_category = std::bidirectional_iterator_tag;
-    using pointer = value_type *;
-    using reference = value_type &;
-
-  private:
-    using VecPtrT = std::conditional_t<std::is_const_v<Ti>, const SmallVec*, SmallVec*>;
-  public:
-    Iterator() = default;
-    Iterator(VecPtrT vec, size_t idx) : vec(vec), idx(idx) {}
-    template<typename To>
-    Iterator(const Iterator<To>& other) : vec(other.vec), idx(other.idx) {} 
-    template<typename To>
-    Iterator(Iterator<To>&& other) : vec(other.vec), idx(other.idx) {} 
-    template<typename To>
-    Iterator<Ti>& operator=(const Iterator<To>& other) {
-      vec = other.vec;
-      idx = other.idx;
-      return *this;
-    }
-    template<typename To>
-    Iterator<Ti>& operator=(Iterator<To>&& other) {
-      vec = other.vec;
-      idx = other.idx;
-      return *this;
-    }
-
-    Iterator operator++(int) {
-      Iterator iter = *this;
-      ++(*this);
-      return iter;
-    }
-    Iterator &operator++() {
-      idx++;
+  SmallVec(std::initializer_list<T> init_list) {
+    reserve(init_list.size());
+    std::uninitialized_copy(init_list.begin(), init_list.end(), data_ptr);
+    _size = init_list.size();
+  }
+  SmallVec(const SmallVec &other) {
+    reserve(other._size);
+    std::uninitialized_copy(other.begin(), other.end(), data_ptr);
+    _size = other._size;
+  }
+  SmallVec(SmallVec &&other) noexcept { take(std::move(other)); }
+  SmallVec &operator=(const SmallVec &other) {
+    if (this == &other)
       return *this;
-    }
-    Iterator &operator--() {
-      idx--;
+    clear();
+    reserve(other._size);
+    std::uninitialized_copy(other.begin(), other.end(), data_ptr);
+    _size = other._size;
+    return *this;
+  }
+  SmallVec &operator=(SmallVec &&other) noexcept {
+    if (this == &other)
       return *this;
-    }
-    Iterator operator--(int) {
-      Iterator iter = *this;
-      --(*this);
-      return iter;
-    }
-    Iterator operator+(int shift) const { return {vec, idx + shift}; }
-    Iterator operator-(int shift) const { return {vec, idx - shift}; }
-
-    reference operator*() const { return (*vec)[idx]; }
-
-    bool operator==(const Iterator &other) const { return (idx == other.idx); }
-    bool operator!=(const Iterator &other) const { return (idx != other.idx); }
-    bool operator<(const Iterator &other) const { return idx < other.idx; }
-    bool operator>(const Iterator &other) const { return other < *this; }
-    bool operator<=(const Iterator &other) const { return !(*this > other); }
-    bool operator>=(const Iterator &other) const { return !(*this < other); }
-
-    difference_type operator-(const Iterator<Ti> &other) const {
-      return idx - other.idx;
-    }
-    
-    VecPtrT vec;
-    size_t idx;
-  };
+    clear();
+    release_heap();
+    take(std::move(other));
+    return *this;
+  }
+  ~SmallVec() {
+    clear();
+    release_heap();
+  }
 
-  using iterator = Iterator<T>;
-  using const_iterator = Iterator<const T>;
+  T &operator[](size_t idx) { return data_ptr[idx]; }
+  const T &operator[](size_t idx) const { return data_ptr[idx]; }
 
-  const T &operator[](size_t idx) const {
-    if (idx >= S) {
-      return overflow_vec[idx - S];
-    } else {
-      return small_arr[idx];
+  template <typename... ArgT>
+  iterator emplace(const_iterator it, ArgT &&...args) {
+    size_t idx = it - data_ptr;
+    if ((idx == _size) && (_size < _capacity)) {
+      new (data_ptr + _size) T(std::forward<ArgT>(args)...);
+      _size += 1;
+      return data_ptr + idx;
     }
-  }
-
-  T& operator[](size_t idx) {
-    return const_cast<T&>(std::as_const(*this)[idx]);
-  }
 
-  template <typename... ArgT> iterator emplace(const_iterator it, ArgT &&...args) {
-    iterator mut_it {this, it.idx};
-    if (_size >= S) {
-      overflow_vec.resize(overflow_vec.size() + 1);
+    // the arguments may refer to our own elements, which are about to move
+    T value(std::forward<ArgT>(args)...);
+    if (_size == _capacity)
+      grow(std::max<size_t>(2 * _capacity, 1));
+    T *slot = data_ptr + idx;
+    if (idx < _size) {
+      if constexpr (RELOCATE_BYTES) {
+        std::memmove(static_cast<void *>(slot + 1), static_cast<void *>(slot),
+                     (_size - idx) * sizeof(T));
+      } else {
+        new (data_ptr + _size) T(std::move(data_ptr[_size - 1]));
+        std::move_backward(slot, data_ptr + _size - 1, data_ptr + _size);
+        slot->~T();
+      }
     }
-    if (it != end())
-      std::ranges::move_backward(mut_it, end(), end() + 1);
-    new (std::addressof(*mut_it)) T(std::forward<ArgT>(args)...);
+    new (slot) T(std::move(value));
     _size += 1;
-    return mut_it;
+    return slot;
   }
 
   template <typename... ArgT> T &emplace_back(ArgT &&...args) {
@@ -122,20 +102,20 @@ public:
   }
 
   iterator erase(const_iterator start, const_iterator stop) {
-    iterator mut_start {this, start.idx};
-    iterator mut_stop {this, stop.idx};
+    T *mut_start = data_ptr + (start - data_ptr);
+    T *mut_stop = data_ptr + (stop - data_ptr);
     if (stop <= start)
       return mut_stop;
-    for (auto src_it = mut_stop, dst_it = mut_start; src_it != end();
-         src_it++, dst_it++) {
-      new (std::addressof(*dst_it)) T(std::move(*src_it));
-      (*src_it).~T();
-    }
 
     size_t n_erased = stop - start;
-    if (_size > S) {
-      overflow_vec.resize(overflow_vec.size() -
-                          std::min(overflow_vec.size(), n_erased));
+    if constexpr (RELOCATE_BYTES) {
+      std::destroy(mut_start, mut_stop);
+      std::memmove(static_cast<void *>(mut_start),
+                   static_cast<void *>(mut_stop),
+                   (end() - mut_stop) * sizeof(T));
+    } else {
+      std::move(mut_stop, end(), mut_start);
+      std::destroy(end() - n_erased, end());
     }
     _size -= n_erased;
     return mut_start;
@@ -143,16 +123,83 @@ public:
 
   iterator erase(const_iterator it) { return erase(it, it + 1); }
 
-  iterator begin() { return {this, 0}; }
-  iterator end() { return {this, _size}; }
-  const_iterator begin() const { return {this, 0}; }
-  const_iterator end() const { return {this, _size}; }
+  /// Ensure space for at least `capacity` elements without reallocation.
+  void reserve(size_t capacity) {
+    if (capacity > _capacity)
+      grow(capacity);
+  }
+
+  void clear() {
+    std::destroy(begin(), end());
+    _size = 0;
+  }
+
+  iterator begin() { return data_ptr; }
+  iterator end() { return data_ptr + _size; }
+  const_iterator begin() const { return data_ptr; }
+  const_iterator end() const { return data_ptr + _size; }
 
+  T *data() { return data_ptr; }
+  const T *data() const { return data_ptr; }
   size_t size() const { return _size; }
+  size_t capacity() const { return _capacity; }
+  bool empty() const { return _size == 0; }
+  /// Whether the elements are stored inside the class.
+  bool is_inline() const { return data_ptr == inline_data(); }
 
 private:
+  T *inline_data() { return reinterpret_cast<T *>(inline_buf); }
+  const T *inline_data() const {
+    return reinterpret_cast<const T *>(inline_buf);
+  }
+
+  /// Move `count` elements from `src` to the uninitialized `dst`, destroying
+  /// the originals.
+  static void relocate(T *src, size_t count, T *dst) {
+    if constexpr (RELOCATE_BYTES) {
+      std::memcpy(static_cast<void *>(dst), static_cast<void *>(src),
+                  count * sizeof(T));
+    } else {
+      std::uninitialized_move_n(src, count, dst);
+      std::destroy_n(src, count);
+    }
+  }
+
+  void grow(size_t new_capacity) {
+    new_capacity = std::max(new_capacity, S);
+    T *new_data = static_cast<T *>(::operator new(
+        new_capacity * sizeof(T), std::align_val_t(alignof(T))));
+    relocate(data_ptr, _size, new_data);
+    release_heap();
+    data_ptr = new_data;
+    _capacity = new_capacity;
+  }
+
+  void release_heap() {
+    if (!is_inline())
+      ::operator delete(data_ptr, std::align_val_t(alignof(T)));
+    data_ptr = inline_data();
+    _capacity = S;
+  }
+
+  /// Take over the elements of `other`. This vector must be empty and not
+  /// hold any heap buffer.
+  void take(SmallVec &&other) {
+    if (other.is_inline()) {
+      relocate(other.data_ptr, other._size, data_ptr);
+    } else {
+      data_ptr = other.data_ptr;
+      _capacity = other._capacity;
+      other.data_ptr = other.inline_data();
+      other._capacity = S;
+    }
+    _size = other._size;
+    other._size = 0;
+  }
+
+  alignas(T) std::byte inline_buf[S * sizeof(T)];
+  T *data_ptr = inline_data();
   size_t _size = 0;
-  std::array<T, S> small_arr;
-  std::vector<T> overflow_vec;
+  size_t _capacity = S;
 };
 } // namespace jay
@@ -0,0 +1,96 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <optional>
+#include <span>
+#include <stdexcept>
+#include <vector>
+
+namespace jay {
+/// A bounded lock-free queue with a single producer and a single consumer,
+/// which may run on different threads.
+///
+/// Both sides keep a cached copy of the other side's index, so that they only
+/// touch the shared cache line of the other index when the cached one says
+/// the ring is full (for the producer) or empty (for the consumer).
+template <typename T> class SpscRing {
+public:
+  /// Create a ring of `capacity` entries, which must be a power of two.
+  explicit SpscRing(size_t capacity) : slots(capacity), mask(capacity - 1) {
+    if ((capacity == 0) || (capacity & (capacity - 1)))
+      throw std::invalid_argument("ring capacity must be a power of two");
+  }
+  SpscRing(const SpscRing &) = delete;
+  SpscRing &operator=(const SpscRing &) = delete;
+
+  /// Append `value` to the ring, returning false (leaving `value` untouched)
+  /// if the ring is full. Called by the producer only.
+  bool push(T &&value) {
+    size_t tail = _tail.load(std::memory_order_relaxed);
+    if (tail - head_cache > mask) {
+      head_cache = _head.load(std::memory_order_acquire);
+      if (tail - head_cache > mask)
+        return false;
+    }
+    slots[tail & mask].emplace(std::move(value));
+    _tail.store(tail + 1, std::memory_order_release);
+    return true;
+  }
+
+  /// Remove the oldest entry from the ring, returning nothing if the ring is
+  /// empty. Called by the consumer only.
+  std::optional<T> pop() {
+    size_t head = _head.load(std::memory_order_relaxed);
+    if ((head == tail_cache) &&
+        (head == (tail_cache = _tail.load(std::memory_order_acquire))))
+      return std::nullopt;
+    std::optional<T> value = std::move(slots[head & mask]);
+    slots[head & mask].reset();
+    _head.store(head + 1, std::memory_order_release);
+    return value;
+  }
+
+  /// Move up to `values.size()` of the oldest entries to `values`, returning
+  /// their number. The entries are released to the producer at once. Called
+  /// by the consumer only.
+  size_t pop_burst(std::span<T> values) {
+    size_t head = _head.load(std::memory_order_relaxed);
+    if (tail_cache - head < values.size())
+      tail_cache = _tail.load(std::memory_order_acquire);
+    size_t count = std::min(tail_cache - head, values.size());
+    for (size_t i = 0; i < count; i++) {
+      std::optional<T> &slot = slots[(head + i) & mask];
+      values[i] = std::move(*slot);
+      slot.reset();
+    }
+    if (count)
+      _head.store(head + count, std::memory_order_release);
+    return count;
+  }
+
+  /// Return the number of entries in the ring, which may be outdated by the
+  /// time it is returned if the other side is running concurrently.
+  size_t size() const {
+    return _tail.load(std::memory_order_acquire) -
+           _head.load(std::memory_order_acquire);
+  }
+  bool empty() const { return size() == 0; }
+  size_t capacity() const { return slots.size(); }
+
+private:
+  static constexpr size_t CACHE_LINE = 64;
+
+  std::vector<std::optional<T>> slots;
+  size_t mask;
+  /// the index of the next entry to pop, written by the consumer
+  alignas(CACHE_LINE) std::atomic<size_t> _head = 0;
+  /// the consumer's copy of [_tail]
+  size_t tail_cache = 0;
+  /// the index of the next entry to push, written by the producer
+  alignas(CACHE_LINE) std::atomic<size_t> _tail = 0;
+  /// the producer's copy of [_head]
+  size_t head_cache = 0;
+};
+} // namespace jay
@@ -1,6 +1,8 @@
 #pragma once
 
+#include <array>
 #include <cstddef>
+#include <type_traits>
 #include <utility>
 #include <variant>
 namespace jay {
@@ -29,6 +31,14 @@ template <typename T> constexpr bool IsArrayLike_v = IsArrayLike<T>::value;
 
 template <typename> constexpr bool DependentFalse_v = false;
 
+/// Trait for types whose instances can be relocated (moved to a new address,
+/// ending the lifetime of the original) by copying their bytes. Holds for all
+/// trivially copyable types and may be specialized for others.
+template <typename T>
+struct IsTriviallyRelocatable : std::is_trivially_copyable<T> {};
+template <typename T>
+constexpr bool IsTriviallyRelocatable_v = IsTriviallyRelocatable<T>::value;
+
 template <typename Ti, typename... Tivar> struct IsVariantAlternative;
 template <typename Ti, typename... Tivar>
 struct IsVariantAlternative<Ti, std::variant<Tivar...>>
@@ -0,0 +1,77 @@
+#pragma once
+
+#include "jay/memory_link.h"
+#include "jay/util/hashtable.h"
+#include <memory>
+#include <optional>
+#include <vector>
+
+namespace jay {
+/// A learning Ethernet switch connecting any number of [MemoryPort]s, each to
+/// be added to a [Stack].
+///
+/// The frames transmitted by the ports are forwarded on [poll], which should
+/// be called together with polling the stacks (from the same thread, see
+/// [MemoryPort]). The switch learns the port of each station from the source
+/// address of its frames, forwarding the frames for a known station to its
+/// port by move. The frames for unknown stations and multicast frames are
+/// flooded to all the other ports, each of which gets a copy of its own.
+class VirtualSwitch {
+public:
+  struct Options {
+    /// entries of the ring in each direction of each port, a power of two
+    size_t ring_size = 1024;
+    uint16_t mtu = 1500;
+    /// whether the ports offload the checksums (see [MemoryPort])
+    bool csum_offload = true;
+  };
+
+  struct Stats {
+    /// frames forwarded to the port of their destination
+    size_t forwarded = 0;
+    /// frames flooded to all the other ports
+    size_t flooded = 0;
+    /// frames dropped because they were malformed, destined to the port they
+    /// came from, or the destination's ring was full
+    size_t dropped = 0;
+  };
+
+  VirtualSwitch() : VirtualSwitch(Options{}) {}
+  explicit VirtualSwitch(Options opts) : opts(opts) {}
+
+  /// Add a port with the MAC address `hwaddr`.
+  std::shared_ptr<MemoryPort> add_port(HWAddr hwaddr);
+
+  /// Forward the frames transmitted by the ports since the last call.
+  void poll();
+
+  /// Return the index (in the order of [add_port]) of the port the station
+  /// `hwaddr` has been learned on, if any.
+  std::optional<size_t> port_of(HWAddr hwaddr) const;
+
+  const Stats &stats() const { return _stats; }
+
+private:
+  static constexpr size_t BURST = 32;
+
+  struct Port {
+    std::shared_ptr<MemoryPort> iface;
+    /// the frames transmitted by the port
+    std::shared_ptr<MemoryPort::Ring> ingress;
+    /// the frames to be received by the port
+    std::shared_ptr<MemoryPort::Ring> egress;
+  };
+
+  void forward(size_t in_port, PBuf packet);
+  /// Push `packet` to the egress ring of `out_port`, dropping it if full.
+  void transmit(size_t out_port, PBuf packet);
+
+  Options opts;
+  std::vector<Port> ports;
+  /// the port each station has last been seen on
+  hash_table<std::array<uint8_t, 6>, size_t> stations;
+  /// storage for the frames popped from the ingress rings
+  std::vector<PBuf> burst;
+  Stats _stats;
+};
+} // namespace jay
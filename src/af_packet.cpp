@@ -0,0 +1,292 @@
+#include "jay/af_packet.h"
+#include "jay/stack.h"
+
+#include <arpa/inet.h>
+#include <array>
+#include <atomic>
+#include <cerrno>
+#include <cstring>
+#include <linux/if_ether.h>
+#include <linux/if_packet.h>
+#include <net/if.h>
+#include <netinet/in.h>
+#include <span>
+#include <stdexcept>
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <system_error>
+#include <unistd.h>
+#include <vector>
+
+namespace jay {
+namespace {
+[[noreturn]] void throw_errno(const char *what) {
+  throw std::system_error(errno, std::system_category(), what);
+}
+
+template <typename T> T load_acquire(T *ptr) {
+  return std::atomic_ref<T>(*ptr).load(std::memory_order_acquire);
+}
+
+template <typename T> void store_release(T *ptr, T value) {
+  std::atomic_ref<T>(*ptr).store(value, std::memory_order_release);
+}
+
+/// offset of the data in a transmission frame
+constexpr size_t TX_DATA_OFF = TPACKET3_HDRLEN - sizeof(sockaddr_ll);
+
+/// Record the partial transport checksum of a received `frame` (see
+/// `TP_STATUS_CSUMNOTREADY`) in `packet`, locating it from the headers, as
+/// the ring doesn't report where it starts. Returns false for frames other
+/// than UDP or TCP directly over IP, whose checksum can't be located.
+bool set_partial_csum(std::span<const uint8_t> frame, PBufStruct &packet) {
+  if (frame.size() < ETH_HLEN)
+    return false;
+  uint16_t ether_type = (frame[12] << 8) | frame[13];
+  size_t ip_off = ETH_HLEN;
+  size_t tspt_off;
+  uint8_t proto;
+  if ((ether_type == ETH_P_IP) && (frame.size() >= ip_off + 20)) {
+    tspt_off = ip_off + (frame[ip_off] & 0xf) * 4;
+    proto = frame[ip_off + 9];
+  } else if ((ether_type == ETH_P_IPV6) && (frame.size() >= ip_off + 40)) {
+    tspt_off = ip_off + 40;
+    proto = frame[ip_off + 6];
+  } else {
+    return false;
+  }
+  size_t csum_offset;
+  if (proto == IPPROTO_UDP)
+    csum_offset = 6;
+  else if (proto == IPPROTO_TCP)
+    csum_offset = 16;
+  else
+    return false;
+  if (tspt_off + csum_offset + 2 > frame.size())
+    return false;
+  packet.tx_csum_partial = true;
+  packet.csum_start = uint16_t(tspt_off);
+  packet.csum_offset = uint16_t(csum_offset);
+  return true;
+}
+} // namespace
+
+struct AfPacketInterface::Ring {
+  int fd = -1;
+  uint8_t *map = nullptr;
+  size_t map_size = 0;
+  uint8_t *rx = nullptr;
+  uint8_t *tx = nullptr;
+  /// whether each receive block is still referenced by received packets
+  std::vector<bool> rx_held;
+
+  Ring() = default;
+  Ring(const Ring &) = delete;
+  ~Ring() {
+    if (map)
+      munmap(map, map_size);
+    if (fd != -1)
+      close(fd);
+  }
+};
+
+AfPacketInterface::AfPacketInterface(const std::string &if_name,
+                                     Options opts)
+    : ring(std::make_shared<Ring>()), opts(opts) {
+  if (if_name.size() + 1 > IFNAMSIZ)
+    throw std::invalid_argument("interface name too long");
+  if (opts.tx_frame_size <= TX_DATA_OFF)
+    throw std::invalid_argument("tx_frame_size too small");
+
+  ring->fd = socket(AF_PACKET, SOCK_RAW | SOCK_CLOEXEC, htons(ETH_P_ALL));
+  if (ring->fd == -1)
+    throw_errno("AF_PACKET socket");
+
+  ifreq ifr{};
+  std::memcpy(ifr.ifr_name, if_name.data(), if_name.size());
+  if (ioctl(ring->fd, SIOCGIFINDEX, &ifr) == -1)
+    throw_errno("SIOCGIFINDEX ioctl");
+  int ifindex = ifr.ifr_ifindex;
+  if (ioctl(ring->fd, SIOCGIFHWADDR, &ifr) == -1)
+    throw_errno("SIOCGIFHWADDR ioctl");
+  std::memcpy(_hwaddr.data(), ifr.ifr_hwaddr.sa_data, _hwaddr.size());
+  if (ioctl(ring->fd, SIOCGIFMTU, &ifr) == -1)
+    throw_errno("SIOCGIFMTU ioctl");
+  _mtu = uint16_t(ifr.ifr_mtu);
+
+  int version = TPACKET_V3;
+  if (setsockopt(ring->fd, SOL_PACKET, PACKET_VERSION, &version,
+                 sizeof(version)) == -1)
+    throw_errno("PACKET_VERSION");
+
+  tpacket_req3 rx_req{};
+  rx_req.tp_block_size = opts.block_size;
+  rx_req.tp_block_nr = opts.block_count;
+  // the frame size only matters for transmission in TPACKET_V3, but must be
+  // valid for the block size
+  rx_req.tp_frame_size = TPACKET_ALIGNMENT << 7;
+  rx_req.tp_frame_nr =
+      opts.block_size / rx_req.tp_frame_size * opts.block_count;
+  rx_req.tp_retire_blk_tov = opts.block_timeout_ms;
+  if (setsockopt(ring->fd, SOL_PACKET, PACKET_RX_RING, &rx_req,
+                 sizeof(rx_req)) == -1)
+    throw_errno("PACKET_RX_RING");
+
+  tpacket_req3 tx_req{};
+  tx_req.tp_frame_size = opts.tx_frame_size;
+  tx_req.tp_block_size = opts.block_size;
+  unsigned frames_per_block = opts.block_size / opts.tx_frame_size;
+  tx_req.tp_block_nr =
+      (opts.tx_frame_count + frames_per_block - 1) / frames_per_block;
+  tx_req.tp_frame_nr = tx_req.tp_block_nr * frames_per_block;
+  this->opts.tx_frame_count = tx_req.tp_frame_nr;
+  if (setsockopt(ring->fd, SOL_PACKET, PACKET_TX_RING, &tx_req,
+                 sizeof(tx_req)) == -1)
+    throw_errno("PACKET_TX_RING");
+
+  size_t rx_size = size_t(rx_req.tp_block_size) * rx_req.tp_block_nr;
+  size_t tx_size = size_t(tx_req.tp_block_size) * tx_req.tp_block_nr;
+  void *map = mmap(nullptr, rx_size + tx_size, PROT_READ | PROT_WRITE,
+                   MAP_SHARED | MAP_LOCKED | MAP_POPULATE, ring->fd, 0);
+  if (map == MAP_FAILED)
+    map = mmap(nullptr, rx_size + tx_size, PROT_READ | PROT_WRITE,
+               MAP_SHARED | MAP_POPULATE, ring->fd, 0);
+  if (map == MAP_FAILED)
+    throw_errno("packet ring mmap");
+  ring->map = static_cast<uint8_t *>(map);
+  ring->map_size = rx_size + tx_size;
+  ring->rx = ring->map;
+  ring->tx = ring->map + rx_size;
+  ring->rx_held.resize(opts.block_count);
+
+  sockaddr_ll sll{};
+  sll.sll_family = AF_PACKET;
+  sll.sll_protocol = htons(ETH_P_ALL);
+  sll.sll_ifindex = ifindex;
+  if (bind(ring->fd, reinterpret_cast<sockaddr *>(&sll), sizeof(sll)) == -1)
+    throw_errno("AF_PACKET bind");
+  // the frames the host transmits on the interface are not for the stack;
+  // older kernels without the option have them skipped in poll_rx_burst
+  int ignore_outgoing = 1;
+  setsockopt(ring->fd, SOL_PACKET, PACKET_IGNORE_OUTGOING, &ignore_outgoing,
+             sizeof(ignore_outgoing));
+}
+
+size_t AfPacketInterface::poll_rx_burst(Stack &stack,
+                                        std::span<PBuf> packets) {
+  size_t n_packets = 0;
+  while (n_packets < packets.size()) {
+    if (!rx_pkts_left) {
+      // the previous block is returned once its frames are released
+      rx_block_chunk = BufChunk();
+      // a block still held from the previous round keeps its user status,
+      // but holds no new frames
+      if (ring->rx_held[rx_block]) {
+        _stats.rx_stalls++;
+        break;
+      }
+      uint8_t *block_ptr = ring->rx + size_t(rx_block) * opts.block_size;
+      auto *block = reinterpret_cast<tpacket_block_desc *>(block_ptr);
+      if (!(load_acquire(&block->hdr.bh1.block_status) & TP_STATUS_USER))
+        break;
+      ring->rx_held[rx_block] = true;
+      rx_block_chunk =
+          BufChunk(block_ptr, opts.block_size, 0,
+                   [ring = ring, block, idx = rx_block](uint8_t *) {
+                     ring->rx_held[idx] = false;
+                     store_release(&block->hdr.bh1.block_status,
+                                   uint32_t(TP_STATUS_KERNEL));
+                   });
+      rx_block = (rx_block + 1) % opts.block_count;
+      rx_pkts_left = block->hdr.bh1.num_pkts;
+      rx_pkt_off = block->hdr.bh1.offset_to_first_pkt;
+      if (!rx_pkts_left)
+        continue;
+    }
+
+    auto *hdr = reinterpret_cast<const tpacket3_hdr *>(rx_block_chunk.begin() +
+                                                      rx_pkt_off);
+    auto *sll = reinterpret_cast<const sockaddr_ll *>(
+        reinterpret_cast<const uint8_t *>(hdr) +
+        TPACKET_ALIGN(sizeof(tpacket3_hdr)));
+    size_t pkt_off = rx_pkt_off;
+    rx_pkt_off += hdr->tp_next_offset;
+    rx_pkts_left--;
+    if (sll->sll_pkttype == PACKET_OUTGOING)
+      continue;
+
+    PBuf &packet = packets[n_packets++];
+    packet = stack.pool.get(
+        Buf(rx_block_chunk.slice(pkt_off + hdr->tp_mac, hdr->tp_snaplen)));
+    // frames sent by a local peer (e.g. over veth) are left with partial
+    // checksums, which only the kernel can vouch for; the ones which can't
+    // be located are left to fail verification
+    if (hdr->tp_status & TP_STATUS_CSUMNOTREADY)
+      packet->rx_csum_valid = set_partial_csum(
+          {reinterpret_cast<const uint8_t *>(hdr) + hdr->tp_mac,
+           hdr->tp_snaplen},
+          *packet);
+    else
+      packet->rx_csum_valid = hdr->tp_status & TP_STATUS_CSUM_VALID;
+    _stats.rx_packets++;
+  }
+  return n_packets;
+}
+
+bool AfPacketInterface::put_tx(const PBuf &packet) {
+  unsigned frames_per_block = opts.block_size / opts.tx_frame_size;
+  uint8_t *frame = ring->tx +
+                   size_t(tx_frame / frames_per_block) * opts.block_size +
+                   size_t(tx_frame % frames_per_block) * opts.tx_frame_size;
+  auto *hdr = reinterpret_cast<tpacket3_hdr *>(frame);
+  if ((packet->size() > opts.tx_frame_size - TX_DATA_OFF) ||
+      (load_acquire(&hdr->tp_status) != TP_STATUS_AVAILABLE))
+    return false;
+
+  std::array<iovec, MAX_SEGMENTS> iov;
+  size_t n_segs = packet->to_iovec(iov);
+  if (n_segs > iov.size())
+    return false;
+  uint8_t *data = frame + TX_DATA_OFF;
+  for (size_t i = 0; i < n_segs; i++) {
+    std::memcpy(data, iov[i].iov_base, iov[i].iov_len);
+    data += iov[i].iov_len;
+  }
+  hdr->tp_len = hdr->tp_snaplen = uint32_t(packet->size());
+  hdr->tp_next_offset = 0;
+  store_release(&hdr->tp_status, uint32_t(TP_STATUS_SEND_REQUEST));
+  tx_frame = (tx_frame + 1) % opts.tx_frame_count;
+  tx_pending = true;
+  return true;
+}
+
+void AfPacketInterface::flush_tx() {
+  if (!tx_pending)
+    return;
+  // a failure (e.g. ENOBUFS) leaves the frames requested for the next flush
+  if (send(ring->fd, nullptr, 0, MSG_DONTWAIT) != -1)
+    tx_pending = false;
+}
+
+void AfPacketInterface::enqueue(PBuf packet) {
+  if (put_tx(packet))
+    _stats.tx_packets++;
+  else
+    _stats.tx_errors++;
+  flush_tx();
+}
+
+void AfPacketInterface::enqueue_burst(std::span<PBuf> packets) {
+  for (PBuf &packet : packets) {
+    if (put_tx(packet))
+      _stats.tx_packets++;
+    else
+      _stats.tx_errors++;
+    packet.reset();
+  }
+  flush_tx();
+}
+
+void AfPacketInterface::poll_tx(Stack &) { flush_tx(); }
+} // namespace jay
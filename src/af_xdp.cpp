@@ -0,0 +1,389 @@
+#include "jay/af_xdp.h"
+#include "jay/stack.h"
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cerrno>
+#include <cstddef>
+#include <cstring>
+#include <linux/bpf.h>
+#include <linux/if_link.h>
+#include <linux/if_xdp.h>
+#include <net/if.h>
+#include <stdexcept>
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/syscall.h>
+#include <system_error>
+#include <unistd.h>
+#include <utility>
+
+namespace jay {
+namespace {
+[[noreturn]] void throw_errno(const char *what) {
+  throw std::system_error(errno, std::system_category(), what);
+}
+
+template <typename T> T load_acquire(T *ptr) {
+  return std::atomic_ref<T>(*ptr).load(std::memory_order_acquire);
+}
+
+template <typename T> void store_release(T *ptr, T value) {
+  std::atomic_ref<T>(*ptr).store(value, std::memory_order_release);
+}
+
+int bpf(int cmd, bpf_attr &attr) {
+  return int(syscall(__NR_bpf, cmd, &attr, sizeof(attr)));
+}
+
+bool is_pow2(uint32_t value) { return value && !(value & (value - 1)); }
+} // namespace
+
+/// The UMEM area, divided into `rx_frames` frames for reception followed by
+/// the frames for transmission.
+///
+/// Each reception frame has its own [ChunkHeader], which the received frames
+/// adopt, so that the frame is put back to the fill ring once the last
+/// reference to it is dropped. The frames may outlive the interface this way,
+/// so the area is unmapped together with this instance when both the
+/// interface and the last frame are gone.
+class AfXdpInterface::Umem {
+public:
+  Umem(uint32_t rx_frames, uint32_t tx_frames, uint32_t frame_size)
+      : frame_size(frame_size), headers(rx_frames) {
+    size = size_t(rx_frames + tx_frames) * frame_size;
+    void *ptr = mmap(nullptr, size, PROT_READ | PROT_WRITE,
+                     MAP_PRIVATE | MAP_ANONYMOUS | MAP_POPULATE, -1, 0);
+    if (ptr == MAP_FAILED)
+      throw_errno("UMEM mmap");
+    area = static_cast<uint8_t *>(ptr);
+    for (uint32_t frame = 0; frame < rx_frames; frame++) {
+      headers[frame].owner = this;
+      headers[frame].frame = frame;
+      headers[frame].data = area + size_t(frame) * frame_size;
+      headers[frame].destroy = &Header::destroy_fn;
+    }
+  }
+
+  /// Stop recycling the frames to the fill ring and unmap the area once none
+  /// of them is lent out.
+  void close() {
+    fill = nullptr;
+    closed = true;
+    if (lent == 0)
+      delete this;
+  }
+
+  /// Reference the `len` bytes at the UMEM address `addr` of a received
+  /// frame. The frame is recycled once the reference is dropped.
+  BufChunk lend(uint64_t addr, uint32_t len) {
+    uint64_t frame = addr / frame_size;
+    Header &header = headers[frame];
+    header.refs = 1;
+    header.pins = 0;
+    lent++;
+    return BufChunk::adopt(&header, len, addr - frame * frame_size);
+  }
+
+  /// Put the reception frame `frame` to the fill ring, which has room for all
+  /// of them.
+  void refill(uint32_t frame) {
+    auto *descs = static_cast<uint64_t *>(fill->descs);
+    descs[fill->cached & fill->mask] = uint64_t(frame) * frame_size;
+    fill->cached++;
+    store_release(fill->producer, fill->cached);
+  }
+
+  uint8_t *area = nullptr;
+  size_t size = 0;
+  uint32_t frame_size;
+  XskRing *fill = nullptr;
+
+private:
+  struct Header : public ChunkHeader {
+    Umem *owner;
+    uint32_t frame;
+
+    static void destroy_fn(ChunkHeader *base) {
+      auto *header = static_cast<Header *>(base);
+      header->owner->give_back(header->frame);
+    }
+  };
+
+  ~Umem() { munmap(area, size); }
+
+  void give_back(uint32_t frame) {
+    lent--;
+    if (!closed)
+      refill(frame);
+    else if (lent == 0)
+      delete this;
+  }
+
+  std::vector<Header> headers;
+  size_t lent = 0;
+  bool closed = false;
+};
+
+AfXdpInterface::AfXdpInterface(const std::string &if_name, Options opts)
+    : opts(opts) {
+  if (if_name.size() + 1 > IFNAMSIZ)
+    throw std::invalid_argument("interface name too long");
+  if (!is_pow2(opts.rx_frames) || !is_pow2(opts.tx_frames))
+    throw std::invalid_argument("frame counts must be powers of two");
+  if (!is_pow2(opts.frame_size) || (opts.frame_size < 2048))
+    throw std::invalid_argument(
+        "frame_size must be a power of two of at least 2048");
+
+  int sock = socket(AF_INET, SOCK_DGRAM | SOCK_CLOEXEC, 0);
+  if (sock == -1)
+    throw_errno("socket");
+  ifreq ifr{};
+  std::memcpy(ifr.ifr_name, if_name.data(), if_name.size());
+  int ifindex = -1;
+  int err = 0;
+  if (ioctl(sock, SIOCGIFINDEX, &ifr) == -1)
+    err = errno;
+  else
+    ifindex = ifr.ifr_ifindex;
+  if (!err && (ioctl(sock, SIOCGIFHWADDR, &ifr) != -1))
+    std::memcpy(_hwaddr.data(), ifr.ifr_hwaddr.sa_data, _hwaddr.size());
+  else if (!err)
+    err = errno;
+  if (!err && (ioctl(sock, SIOCGIFMTU, &ifr) != -1))
+    _mtu = uint16_t(ifr.ifr_mtu);
+  else if (!err)
+    err = errno;
+  close(sock);
+  if (err)
+    throw std::system_error(err, std::system_category(), "interface ioctl");
+
+  try {
+    setup_socket(ifindex);
+    setup_program(ifindex);
+  } catch (...) {
+    teardown();
+    throw;
+  }
+}
+
+AfXdpInterface::~AfXdpInterface() { teardown(); }
+
+void AfXdpInterface::setup_socket(int ifindex) {
+  xsk_fd = socket(AF_XDP, SOCK_RAW | SOCK_CLOEXEC, 0);
+  if (xsk_fd == -1)
+    throw_errno("AF_XDP socket");
+
+  umem = new Umem(opts.rx_frames, opts.tx_frames, opts.frame_size);
+  xdp_umem_reg reg{};
+  reg.addr = reinterpret_cast<uint64_t>(umem->area);
+  reg.len = umem->size;
+  reg.chunk_size = opts.frame_size;
+  if (setsockopt(xsk_fd, SOL_XDP, XDP_UMEM_REG, &reg, sizeof(reg)) == -1)
+    throw_errno("XDP_UMEM_REG");
+
+  auto set_ring_size = [&](int optname, uint32_t size, const char *what) {
+    if (setsockopt(xsk_fd, SOL_XDP, optname, &size, sizeof(size)) == -1)
+      throw_errno(what);
+  };
+  set_ring_size(XDP_UMEM_FILL_RING, opts.rx_frames, "XDP_UMEM_FILL_RING");
+  set_ring_size(XDP_UMEM_COMPLETION_RING, opts.tx_frames,
+                "XDP_UMEM_COMPLETION_RING");
+  set_ring_size(XDP_RX_RING, opts.rx_frames, "XDP_RX_RING");
+  set_ring_size(XDP_TX_RING, opts.tx_frames, "XDP_TX_RING");
+
+  xdp_mmap_offsets offsets{};
+  socklen_t offsets_len = sizeof(offsets);
+  if (getsockopt(xsk_fd, SOL_XDP, XDP_MMAP_OFFSETS, &offsets, &offsets_len) ==
+      -1)
+    throw_errno("XDP_MMAP_OFFSETS");
+
+  auto map_ring = [&](XskRing &ring, const xdp_ring_offset &off,
+                      uint32_t size, size_t desc_size, off_t pgoff) {
+    ring.map_size = off.desc + size * desc_size;
+    void *map = mmap(nullptr, ring.map_size, PROT_READ | PROT_WRITE,
+                     MAP_SHARED | MAP_POPULATE, xsk_fd, pgoff);
+    if (map == MAP_FAILED)
+      throw_errno("AF_XDP ring mmap");
+    auto *base = static_cast<uint8_t *>(map);
+    ring.map = map;
+    ring.producer = reinterpret_cast<uint32_t *>(base + off.producer);
+    ring.consumer = reinterpret_cast<uint32_t *>(base + off.consumer);
+    ring.flags = reinterpret_cast<uint32_t *>(base + off.flags);
+    ring.descs = base + off.desc;
+    ring.mask = size - 1;
+  };
+  map_ring(rx, offsets.rx, opts.rx_frames, sizeof(xdp_desc),
+           XDP_PGOFF_RX_RING);
+  map_ring(tx, offsets.tx, opts.tx_frames, sizeof(xdp_desc),
+           XDP_PGOFF_TX_RING);
+  map_ring(fill, offsets.fr, opts.rx_frames, sizeof(uint64_t),
+           XDP_UMEM_PGOFF_FILL_RING);
+  map_ring(comp, offsets.cr, opts.tx_frames, sizeof(uint64_t),
+           XDP_UMEM_PGOFF_COMPLETION_RING);
+
+  umem->fill = &fill;
+  for (uint32_t frame = 0; frame < opts.rx_frames; frame++)
+    umem->refill(frame);
+  free_tx.reserve(opts.tx_frames);
+  for (uint32_t frame = opts.rx_frames + opts.tx_frames;
+       frame > opts.rx_frames; frame--)
+    free_tx.push_back(uint64_t(frame - 1) * opts.frame_size);
+
+  sockaddr_xdp sxdp{};
+  sxdp.sxdp_family = AF_XDP;
+  sxdp.sxdp_flags = XDP_USE_NEED_WAKEUP | (opts.generic_mode ? XDP_COPY : 0);
+  sxdp.sxdp_ifindex = ifindex;
+  sxdp.sxdp_queue_id = opts.queue_id;
+  if (bind(xsk_fd, reinterpret_cast<sockaddr *>(&sxdp), sizeof(sxdp)) == -1)
+    throw_errno("AF_XDP bind");
+}
+
+void AfXdpInterface::setup_program(int ifindex) {
+  bpf_attr attr{};
+  attr.map_type = BPF_MAP_TYPE_XSKMAP;
+  attr.key_size = sizeof(uint32_t);
+  attr.value_size = sizeof(uint32_t);
+  attr.max_entries = opts.queue_id + 1;
+  map_fd = bpf(BPF_MAP_CREATE, attr);
+  if (map_fd == -1)
+    throw_errno("BPF_MAP_CREATE");
+
+  uint32_t key = opts.queue_id;
+  uint32_t value = uint32_t(xsk_fd);
+  attr = {};
+  attr.map_fd = uint32_t(map_fd);
+  attr.key = reinterpret_cast<uint64_t>(&key);
+  attr.value = reinterpret_cast<uint64_t>(&value);
+  if (bpf(BPF_MAP_UPDATE_ELEM, attr) == -1)
+    throw_errno("BPF_MAP_UPDATE_ELEM");
+
+  // return bpf_redirect_map(&xsks, ctx->rx_queue_index, XDP_PASS);
+  const bpf_insn insns[] = {
+      {BPF_LDX | BPF_MEM | BPF_W, BPF_REG_2, BPF_REG_1,
+       int16_t(offsetof(xdp_md, rx_queue_index)), 0},
+      {BPF_LD | BPF_DW | BPF_IMM, BPF_REG_1, BPF_PSEUDO_MAP_FD, 0, map_fd},
+      {0, 0, 0, 0, 0},
+      {BPF_ALU64 | BPF_MOV | BPF_K, BPF_REG_3, 0, 0, XDP_PASS},
+      {BPF_JMP | BPF_CALL, 0, 0, 0, BPF_FUNC_redirect_map},
+      {BPF_JMP | BPF_EXIT, 0, 0, 0, 0},
+  };
+  static const char license[] = "Dual BSD/GPL";
+  attr = {};
+  attr.prog_type = BPF_PROG_TYPE_XDP;
+  attr.insn_cnt = std::size(insns);
+  attr.insns = reinterpret_cast<uint64_t>(insns);
+  attr.license = reinterpret_cast<uint64_t>(license);
+  prog_fd = bpf(BPF_PROG_LOAD, attr);
+  if (prog_fd == -1)
+    throw_errno("BPF_PROG_LOAD");
+
+  attr = {};
+  attr.link_create.prog_fd = uint32_t(prog_fd);
+  attr.link_create.target_ifindex = uint32_t(ifindex);
+  attr.link_create.attach_type = BPF_XDP;
+  attr.link_create.flags =
+      opts.generic_mode ? XDP_FLAGS_SKB_MODE : XDP_FLAGS_DRV_MODE;
+  link_fd = bpf(BPF_LINK_CREATE, attr);
+  if (link_fd == -1)
+    throw_errno("BPF_LINK_CREATE");
+}
+
+void AfXdpInterface::teardown() {
+  // closing the link detaches the program
+  for (int *fd : {&link_fd, &prog_fd, &map_fd})
+    if (*fd != -1)
+      close(std::exchange(*fd, -1));
+  for (XskRing *ring : {&rx, &tx, &fill, &comp})
+    if (ring->map)
+      munmap(std::exchange(ring->map, nullptr), ring->map_size);
+  if (umem)
+    std::exchange(umem, nullptr)->close();
+  if (xsk_fd != -1)
+    close(std::exchange(xsk_fd, -1));
+}
+
+size_t AfXdpInterface::poll_rx_burst(Stack &stack, std::span<PBuf> packets) {
+  uint32_t available = load_acquire(rx.producer) - rx.cached;
+  if (!available) {
+    // the kernel only asks to be woken up when it runs out of frames to fill
+    if (load_acquire(fill.flags) & XDP_RING_NEED_WAKEUP)
+      recvfrom(xsk_fd, nullptr, 0, MSG_DONTWAIT, nullptr, nullptr);
+    return 0;
+  }
+
+  auto *descs = static_cast<const xdp_desc *>(rx.descs);
+  size_t n_packets = std::min<size_t>(available, packets.size());
+  for (size_t i = 0; i < n_packets; i++) {
+    const xdp_desc &desc = descs[rx.cached++ & rx.mask];
+    packets[i] = stack.pool.get(Buf(umem->lend(desc.addr, desc.len)));
+  }
+  store_release(rx.consumer, rx.cached);
+  _stats.rx_packets += n_packets;
+  return n_packets;
+}
+
+bool AfXdpInterface::put_tx(const PBuf &packet) {
+  if (free_tx.empty() || (packet->size() > opts.frame_size) ||
+      (tx.cached - load_acquire(tx.consumer) > tx.mask))
+    return false;
+  std::array<iovec, MAX_SEGMENTS> iov;
+  size_t n_segs = packet->to_iovec(iov);
+  if (n_segs > iov.size())
+    return false;
+
+  uint64_t addr = free_tx.back();
+  free_tx.pop_back();
+  uint8_t *data = umem->area + addr;
+  for (size_t i = 0; i < n_segs; i++) {
+    std::memcpy(data, iov[i].iov_base, iov[i].iov_len);
+    data += iov[i].iov_len;
+  }
+  auto *descs = static_cast<xdp_desc *>(tx.descs);
+  descs[tx.cached++ & tx.mask] = {addr, uint32_t(packet->size()), 0};
+  return true;
+}
+
+void AfXdpInterface::flush_tx() {
+  if (tx.cached == *tx.producer)
+    return;
+  store_release(tx.producer, tx.cached);
+  // in copy mode, the kernel transmits only when woken up
+  if (load_acquire(tx.flags) & XDP_RING_NEED_WAKEUP)
+    sendto(xsk_fd, nullptr, 0, MSG_DONTWAIT, nullptr, 0);
+}
+
+void AfXdpInterface::enqueue(PBuf packet) {
+  if (put_tx(packet))
+    _stats.tx_packets++;
+  else
+    _stats.tx_errors++;
+  flush_tx();
+}
+
+void AfXdpInterface::enqueue_burst(std::span<PBuf> packets) {
+  for (PBuf &packet : packets) {
+    if (put_tx(packet))
+      _stats.tx_packets++;
+    else
+      _stats.tx_errors++;
+    packet.reset();
+  }
+  flush_tx();
+}
+
+void AfXdpInterface::poll_tx(Stack &) {
+  uint32_t completed = load_acquire(comp.producer) - comp.cached;
+  auto *descs = static_cast<const uint64_t *>(comp.descs);
+  for (uint32_t i = 0; i < completed; i++)
+    free_tx.push_back(descs[comp.cached++ & comp.mask]);
+  store_release(comp.consumer, comp.cached);
+
+  // kick the transmission again if the kernel stopped short (e.g. EAGAIN)
+  if ((load_acquire(tx.consumer) != tx.cached) &&
+      (load_acquire(tx.flags) & XDP_RING_NEED_WAKEUP))
+    sendto(xsk_fd, nullptr, 0, MSG_DONTWAIT, nullptr, 0);
+}
+} // namespace jay
@@ -0,0 +1,258 @@
+#include "jay/util/csum.h"
+
+#include <cstring>
+#include <stdexcept>
+
+#if defined(__x86_64__)
+#include <immintrin.h>
+#define JAY_CSUM_X86 1
+#endif
+
+namespace jay {
+namespace {
+/// Number of bytes summed by a kernel before the sum is folded into the
+/// caller's sum. The per-block sums of 32-bit words stay well below 2^64.
+constexpr size_t BLOCK_SIZE = size_t(1) << 30;
+
+using KernelFn = uint64_t (*)(const uint8_t *, size_t, uint8_t *);
+
+/// Sum and (if `Copy`) copy to `dst` the tail left over by the vector loops.
+template <bool Copy>
+uint64_t csum_tail(const uint8_t *data, size_t len, uint8_t *dst) {
+  if constexpr (Copy)
+    std::memcpy(dst, data, len);
+  return csum_words(data, len);
+}
+
+// The kernels sum `len` bytes at `data`. The `Copy` instantiations also store
+// the bytes to `dst` from the registers they were summed in, so that copying
+// the data does not need another pass over it (see [csum_copy]).
+
+template <bool Copy>
+uint64_t csum_scalar(const uint8_t *data, size_t len, uint8_t *dst) {
+  uint64_t sum0 = 0, sum1 = 0;
+  while (len >= 16) {
+    uint64_t words[2];
+    std::memcpy(words, data, 16);
+    if constexpr (Copy) {
+      std::memcpy(dst, words, 16);
+      dst += 16;
+    }
+    sum0 += (words[0] & 0xffffffff) + (words[0] >> 32);
+    sum1 += (words[1] & 0xffffffff) + (words[1] >> 32);
+    data += 16;
+    len -= 16;
+  }
+  return sum0 + sum1 + csum_tail<Copy>(data, len, dst);
+}
+
+#ifdef JAY_CSUM_X86
+template <bool Copy>
+__attribute__((target("sse2"))) uint64_t
+csum_sse2(const uint8_t *data, size_t len, uint8_t *dst) {
+  const __m128i zero = _mm_setzero_si128();
+  __m128i acc0 = zero, acc1 = zero;
+  while (len >= 32) {
+    __m128i lo = _mm_loadu_si128(reinterpret_cast<const __m128i *>(data));
+    __m128i hi = _mm_loadu_si128(reinterpret_cast<const __m128i *>(data + 16));
+    if constexpr (Copy) {
+      _mm_storeu_si128(reinterpret_cast<__m128i *>(dst), lo);
+      _mm_storeu_si128(reinterpret_cast<__m128i *>(dst + 16), hi);
+      dst += 32;
+    }
+    acc0 = _mm_add_epi64(acc0, _mm_unpacklo_epi32(lo, zero));
+    acc1 = _mm_add_epi64(acc1, _mm_unpackhi_epi32(lo, zero));
+    acc0 = _mm_add_epi64(acc0, _mm_unpacklo_epi32(hi, zero));
+    acc1 = _mm_add_epi64(acc1, _mm_unpackhi_epi32(hi, zero));
+    data += 32;
+    len -= 32;
+  }
+  if (len >= 16) {
+    __m128i lo = _mm_loadu_si128(reinterpret_cast<const __m128i *>(data));
+    if constexpr (Copy) {
+      _mm_storeu_si128(reinterpret_cast<__m128i *>(dst), lo);
+      dst += 16;
+    }
+    acc0 = _mm_add_epi64(acc0, _mm_unpacklo_epi32(lo, zero));
+    acc1 = _mm_add_epi64(acc1, _mm_unpackhi_epi32(lo, zero));
+    data += 16;
+    len -= 16;
+  }
+  __m128i acc = _mm_add_epi64(acc0, acc1);
+  uint64_t sum = uint64_t(_mm_cvtsi128_si64(acc)) +
+                 uint64_t(_mm_cvtsi128_si64(_mm_unpackhi_epi64(acc, acc)));
+  return sum + csum_tail<Copy>(data, len, dst);
+}
+
+template <bool Copy>
+__attribute__((target("avx2"))) uint64_t
+csum_avx2(const uint8_t *data, size_t len, uint8_t *dst) {
+  const __m256i zero = _mm256_setzero_si256();
+  __m256i acc0 = zero, acc1 = zero;
+  while (len >= 64) {
+    __m256i lo = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(data));
+    __m256i hi =
+        _mm256_loadu_si256(reinterpret_cast<const __m256i *>(data + 32));
+    if constexpr (Copy) {
+      _mm256_storeu_si256(reinterpret_cast<__m256i *>(dst), lo);
+      _mm256_storeu_si256(reinterpret_cast<__m256i *>(dst + 32), hi);
+      dst += 64;
+    }
+    acc0 = _mm256_add_epi64(acc0, _mm256_unpacklo_epi32(lo, zero));
+    acc1 = _mm256_add_epi64(acc1, _mm256_unpackhi_epi32(lo, zero));
+    acc0 = _mm256_add_epi64(acc0, _mm256_unpacklo_epi32(hi, zero));
+    acc1 = _mm256_add_epi64(acc1, _mm256_unpackhi_epi32(hi, zero));
+    data += 64;
+    len -= 64;
+  }
+  if (len >= 32) {
+    __m256i lo = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(data));
+    if constexpr (Copy) {
+      _mm256_storeu_si256(reinterpret_cast<__m256i *>(dst), lo);
+      dst += 32;
+    }
+    acc0 = _mm256_add_epi64(acc0, _mm256_unpacklo_epi32(lo, zero));
+    acc1 = _mm256_add_epi64(acc1, _mm256_unpackhi_epi32(lo, zero));
+    data += 32;
+    len -= 32;
+  }
+  __m256i acc = _mm256_add_epi64(acc0, acc1);
+  __m128i acc128 = _mm_add_epi64(_mm256_castsi256_si128(acc),
+                                 _mm256_extracti128_si256(acc, 1));
+  uint64_t sum =
+      uint64_t(_mm_cvtsi128_si64(acc128)) +
+      uint64_t(_mm_cvtsi128_si64(_mm_unpackhi_epi64(acc128, acc128)));
+  return sum + csum_tail<Copy>(data, len, dst);
+}
+
+template <bool Copy>
+__attribute__((target("avx512f"))) uint64_t
+csum_avx512(const uint8_t *data, size_t len, uint8_t *dst) {
+  const __m512i zero = _mm512_setzero_si512();
+  __m512i acc0 = zero, acc1 = zero;
+  while (len >= 128) {
+    __m512i lo = _mm512_loadu_si512(data);
+    __m512i hi = _mm512_loadu_si512(data + 64);
+    if constexpr (Copy) {
+      _mm512_storeu_si512(dst, lo);
+      _mm512_storeu_si512(dst + 64, hi);
+      dst += 128;
+    }
+    acc0 = _mm512_add_epi64(acc0, _mm512_unpacklo_epi32(lo, zero));
+    acc1 = _mm512_add_epi64(acc1, _mm512_unpackhi_epi32(lo, zero));
+    acc0 = _mm512_add_epi64(acc0, _mm512_unpacklo_epi32(hi, zero));
+    acc1 = _mm512_add_epi64(acc1, _mm512_unpackhi_epi32(hi, zero));
+    data += 128;
+    len -= 128;
+  }
+  if (len >= 64) {
+    __m512i lo = _mm512_loadu_si512(data);
+    if constexpr (Copy) {
+      _mm512_storeu_si512(dst, lo);
+      dst += 64;
+    }
+    acc0 = _mm512_add_epi64(acc0, _mm512_unpacklo_epi32(lo, zero));
+    acc1 = _mm512_add_epi64(acc1, _mm512_unpackhi_epi32(lo, zero));
+    data += 64;
+    len -= 64;
+  }
+  uint64_t sum = _mm512_reduce_add_epi64(_mm512_add_epi64(acc0, acc1));
+  return sum + csum_tail<Copy>(data, len, dst);
+}
+#endif
+
+template <bool Copy> KernelFn kernel(CsumImpl impl) {
+  switch (impl) {
+#ifdef JAY_CSUM_X86
+  case CsumImpl::SSE2:
+    return csum_sse2<Copy>;
+  case CsumImpl::AVX2:
+    return csum_avx2<Copy>;
+  case CsumImpl::AVX512:
+    return csum_avx512<Copy>;
+#endif
+  default:
+    return csum_scalar<Copy>;
+  }
+}
+
+CsumImpl select_impl() {
+  for (CsumImpl impl : {CsumImpl::AVX512, CsumImpl::AVX2, CsumImpl::SSE2}) {
+    if (csum_supported(impl))
+      return impl;
+  }
+  return CsumImpl::SCALAR;
+}
+
+/// The kernels selected for the CPU. They are selected on first use rather
+/// than by a namespace-scope initializer, as checksums may be computed from
+/// the static initializers of other translation units, which can run first.
+struct Selection {
+  CsumImpl impl = select_impl();
+  KernelFn partial = kernel<false>(impl);
+  KernelFn copy = kernel<true>(impl);
+};
+
+const Selection &selection() {
+  static const Selection sel;
+  return sel;
+}
+
+uint64_t csum_blocks(KernelFn fn, std::span<const uint8_t> data,
+                     uint64_t sum, uint8_t *dst = nullptr) {
+  while (data.size() > BLOCK_SIZE) {
+    sum = csum_add(sum, fn(data.data(), BLOCK_SIZE, dst));
+    data = data.subspan(BLOCK_SIZE);
+    if (dst)
+      dst += BLOCK_SIZE;
+  }
+  return csum_add(sum, fn(data.data(), data.size(), dst));
+}
+} // namespace
+
+bool csum_supported(CsumImpl impl) {
+#ifdef JAY_CSUM_X86
+  // may run from static initializers before the CPU model is initialized
+  __builtin_cpu_init();
+#endif
+  switch (impl) {
+  case CsumImpl::SCALAR:
+    return true;
+#ifdef JAY_CSUM_X86
+  case CsumImpl::SSE2:
+    return __builtin_cpu_supports("sse2");
+  case CsumImpl::AVX2:
+    return __builtin_cpu_supports("avx2");
+  case CsumImpl::AVX512:
+    return __builtin_cpu_supports("avx512f");
+#endif
+  default:
+    return false;
+  }
+}
+
+CsumImpl csum_selected() { return selection().impl; }
+
+uint64_t csum_partial_dispatch(std::span<const uint8_t> data, uint64_t sum) {
+  return csum_blocks(selection().partial, data, sum);
+}
+
+uint64_t csum_partial(std::span<const uint8_t> data, uint64_t sum,
+                      CsumImpl impl) {
+  if (!csum_supported(impl))
+    throw std::invalid_argument("checksum kernel not supported by the CPU");
+  return csum_blocks(kernel<false>(impl), data, sum);
+}
+
+uint64_t csum_copy_dispatch(std::span<const uint8_t> src, uint8_t *dst,
+                            uint64_t sum) {
+  return csum_blocks(selection().copy, src, sum, dst);
+}
+
+uint64_t csum_copy(std::span<const uint8_t> src, uint8_t *dst, uint64_t sum,
+                   CsumImpl impl) {
+  if (!csum_supported(impl))
+    throw std::invalid_argument("checksum kernel not supported by the CPU");
+  return csum_blocks(kernel<true>(impl), src, sum, dst);
+}
+} // namespace jay
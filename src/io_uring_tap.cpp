@@ -0,0 +1,607 @@
+#include "jay/io_uring_tap.h"
+#include "jay/stack.h"
+#include "jay/util/csum.h"
+
+#include <atomic>
+#include <arpa/inet.h>
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <linux/if_tun.h>
+#include <linux/io_uring.h>
+#include <net/if.h>
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <stdexcept>
+#include <sys/syscall.h>
+#include <system_error>
+#include <unistd.h>
+
+namespace jay {
+namespace {
+// the kernel headers of older distributions lack the opcode (Linux 6.7)
+constexpr uint8_t OP_READ_MULTISHOT = 49;
+/// the buffer group of the receive buffers
+constexpr uint16_t RX_BGID = 0;
+/// `user_data` of the reads, writes being tagged by their slot
+constexpr uint64_t RX_USER_DATA = ~uint64_t(0);
+/// single-shot reads kept in flight without multishot support
+constexpr unsigned RX_FALLBACK_READS = 8;
+// the kernel headers of older distributions lack UDP segmentation offload
+// (Linux 6.2)
+constexpr unsigned OFFLOAD_USO4 = 0x20;
+constexpr unsigned OFFLOAD_USO6 = 0x40;
+// the `virtio_net_hdr` flags and GSO types (see [VnetHdr])
+constexpr uint8_t VNET_F_NEEDS_CSUM = 1;
+constexpr uint8_t VNET_F_DATA_VALID = 2;
+constexpr uint8_t VNET_GSO_NONE = 0;
+constexpr uint8_t VNET_GSO_UDP = 3;
+constexpr uint8_t VNET_GSO_UDP_L4 = 5;
+constexpr size_t UDP_HDR_SIZE = 8;
+
+uint16_t load_be16(const uint8_t *ptr) {
+  uint16_t value;
+  std::memcpy(&value, ptr, sizeof(value));
+  return ntohs(value);
+}
+
+void store_be16(uint8_t *ptr, uint16_t value) {
+  value = htons(value);
+  std::memcpy(ptr, &value, sizeof(value));
+}
+
+int io_uring_setup(unsigned entries, io_uring_params *params) {
+  return int(syscall(__NR_io_uring_setup, entries, params));
+}
+
+int io_uring_enter(int fd, unsigned to_submit, unsigned min_complete,
+                   unsigned flags) {
+  return int(syscall(__NR_io_uring_enter, fd, to_submit, min_complete, flags,
+                     nullptr, 0));
+}
+
+int io_uring_register(int fd, unsigned opcode, void *arg, unsigned nr_args) {
+  return int(syscall(__NR_io_uring_register, fd, opcode, arg, nr_args));
+}
+
+template <typename T> T load_acquire(T *ptr) {
+  return std::atomic_ref<T>(*ptr).load(std::memory_order_acquire);
+}
+
+template <typename T> void store_release(T *ptr, T value) {
+  std::atomic_ref<T>(*ptr).store(value, std::memory_order_release);
+}
+
+[[noreturn]] void throw_errno(const char *what) {
+  throw std::system_error(errno, std::system_category(), what);
+}
+
+void *map_ring(int fd, size_t size, off_t offset) {
+  void *ptr = mmap(nullptr, size, PROT_READ | PROT_WRITE,
+                   MAP_SHARED | MAP_POPULATE, fd, offset);
+  if (ptr == MAP_FAILED)
+    throw_errno("io_uring mmap");
+  return ptr;
+}
+} // namespace
+
+/// The receive buffers, provided to the kernel through a buffer ring.
+///
+/// Each buffer has its own [ChunkHeader], which the received frames adopt, so
+/// that the buffer is recycled once the last reference to the frame is
+/// dropped. The buffers may outlive the interface this way, so they are freed
+/// together with this instance when both the interface and the last frame are
+/// gone.
+class IoUringTapInterface::RxBuffers {
+public:
+  RxBuffers(int ring_fd, uint16_t count, size_t buf_size,
+            std::pmr::memory_resource *mem)
+      : mem(mem), buf_size(buf_size), count(count), headers(count) {
+    ring_size = count * sizeof(io_uring_buf);
+    void *ring_ptr = mmap(nullptr, ring_size, PROT_READ | PROT_WRITE,
+                          MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (ring_ptr == MAP_FAILED)
+      throw_errno("buffer ring mmap");
+    ring = static_cast<io_uring_buf_ring *>(ring_ptr);
+
+    io_uring_buf_reg reg{};
+    reg.ring_addr = reinterpret_cast<uint64_t>(ring);
+    reg.ring_entries = count;
+    reg.bgid = RX_BGID;
+    if (io_uring_register(ring_fd, IORING_REGISTER_PBUF_RING, &reg, 1) < 0) {
+      int err = errno;
+      munmap(ring, ring_size);
+      throw std::system_error(err, std::system_category(),
+                              "IORING_REGISTER_PBUF_RING");
+    }
+
+    data = static_cast<uint8_t *>(mem->allocate(count * buf_size, 64));
+    returned.reserve(count);
+    for (uint16_t bid = 0; bid < count; bid++) {
+      headers[bid].owner = this;
+      headers[bid].bid = bid;
+      headers[bid].data = data + bid * buf_size;
+      headers[bid].destroy = &Header::destroy_fn;
+      returned.push_back(bid);
+    }
+    publish();
+  }
+
+  /// Unregister the ring, after which the kernel no longer writes to the
+  /// buffers, and free the buffers once none of them is lent out.
+  void close(int ring_fd) {
+    io_uring_buf_reg reg{};
+    reg.bgid = RX_BGID;
+    io_uring_register(ring_fd, IORING_UNREGISTER_PBUF_RING, &reg, 1);
+    munmap(ring, ring_size);
+    closed = true;
+    if (lent == 0)
+      delete this;
+  }
+
+  /// Reference the first `size` bytes of the buffer `bid`, which the kernel
+  /// has filled. The buffer is recycled once the reference is dropped.
+  BufChunk lend(uint16_t bid, size_t size) {
+    Header &header = headers[bid];
+    header.refs = 1;
+    header.pins = 0;
+    lent++;
+    return BufChunk::adopt(&header, size);
+  }
+
+  /// Give the buffer `bid` back to the kernel without lending it out.
+  void recycle(uint16_t bid) { returned.push_back(bid); }
+
+  /// Add the recycled buffers to the ring.
+  void publish() {
+    if (returned.empty())
+      return;
+    // not `ring->bufs`: the flexible array is wrapped in a struct with an
+    // empty member, which takes a byte in C++ and misplaces the array
+    auto *bufs = reinterpret_cast<io_uring_buf *>(ring);
+    uint16_t mask = count - 1;
+    for (uint16_t bid : returned) {
+      io_uring_buf &buf = bufs[ring_tail & mask];
+      buf.addr = reinterpret_cast<uint64_t>(headers[bid].data);
+      buf.len = uint32_t(buf_size);
+      buf.bid = bid;
+      ring_tail++;
+    }
+    returned.clear();
+    store_release(&ring->tail, ring_tail);
+  }
+
+private:
+  struct Header : public ChunkHeader {
+    RxBuffers *owner;
+    uint16_t bid;
+
+    static void destroy_fn(ChunkHeader *base) {
+      auto *header = static_cast<Header *>(base);
+      header->owner->give_back(header->bid);
+    }
+  };
+
+  ~RxBuffers() { mem->deallocate(data, count * buf_size, 64); }
+
+  void give_back(uint16_t bid) {
+    lent--;
+    if (!closed)
+      returned.push_back(bid);
+    else if (lent == 0)
+      delete this;
+  }
+
+  std::pmr::memory_resource *mem;
+  uint8_t *data = nullptr;
+  size_t buf_size;
+  uint16_t count;
+  io_uring_buf_ring *ring;
+  size_t ring_size;
+  uint16_t ring_tail = 0;
+  std::vector<Header> headers;
+  /// buffers to be added to the ring on the next [publish]
+  std::vector<uint16_t> returned;
+  size_t lent = 0;
+  bool closed = false;
+};
+
+IoUringTapInterface::IoUringTapInterface(std::string if_name, HWAddr hwaddr,
+                                         uint16_t mtu, Options opts,
+                                         std::pmr::memory_resource *mem)
+    : if_name(std::move(if_name)), _hwaddr(hwaddr), _mtu(mtu), opts(opts) {
+  if (this->if_name.size() + 1 > IFNAMSIZ)
+    throw std::invalid_argument("interface name too long");
+  if ((opts.rx_buffers == 0) || (opts.rx_buffers & (opts.rx_buffers - 1)))
+    throw std::invalid_argument("rx_buffers must be a power of two");
+  size_t vnet_hdr_size = opts.vnet_hdr ? sizeof(VnetHdr) : 0;
+  if (opts.rx_buffer_size < vnet_hdr_size + mtu + EthHeader::SIZE)
+    throw std::invalid_argument("rx_buffer_size must fit a frame of the MTU");
+
+  try {
+    // the descriptor stays blocking: io_uring waits for readiness itself,
+    // whereas reads from a non-blocking one would complete with EAGAIN
+    tap_fd = open("/dev/net/tun", O_RDWR | O_CLOEXEC);
+    if (tap_fd == -1)
+      throw_errno("open /dev/net/tun");
+    ifreq ifr{};
+    ifr.ifr_flags = IFF_TAP | IFF_NO_PI;
+    if (opts.multi_queue)
+      ifr.ifr_flags |= IFF_MULTI_QUEUE;
+    if (opts.vnet_hdr)
+      ifr.ifr_flags |= IFF_VNET_HDR;
+    std::memcpy(ifr.ifr_name, this->if_name.data(), this->if_name.size());
+    if (ioctl(tap_fd, TUNSETIFF, &ifr) == -1)
+      throw_errno("TUNSETIFF ioctl");
+    if (opts.vnet_hdr) {
+      // the kernel may send partial checksums, and super-packets if they fit
+      // the receive buffers
+      unsigned offload = TUN_F_CSUM;
+      if (opts.rx_buffer_size >= RX_GSO_BUFFER_SIZE)
+        offload |= OFFLOAD_USO4 | OFFLOAD_USO6;
+      // kernels without UDP segmentation offload reject it
+      if ((ioctl(tap_fd, TUNSETOFFLOAD, offload) == -1) &&
+          ((errno != EINVAL) ||
+           (ioctl(tap_fd, TUNSETOFFLOAD, TUN_F_CSUM) == -1)))
+        throw_errno("TUNSETOFFLOAD ioctl");
+    }
+
+    int sock = socket(AF_INET, SOCK_DGRAM | SOCK_CLOEXEC, 0);
+    if (sock == -1)
+      throw_errno("socket");
+    ifr.ifr_mtu = mtu;
+    int res = ioctl(sock, SIOCSIFMTU, &ifr);
+    int err = errno;
+    close(sock);
+    if (res == -1)
+      throw std::system_error(err, std::system_category(), "SIOCSIFMTU ioctl");
+
+    setup_ring(opts.queue_depth);
+    rx_bufs = new RxBuffers(ring_fd, opts.rx_buffers, opts.rx_buffer_size, mem);
+  } catch (...) {
+    teardown();
+    throw;
+  }
+
+  tx_slots.resize(opts.queue_depth);
+  free_tx_slots.reserve(opts.queue_depth);
+  for (uint32_t slot = opts.queue_depth; slot > 0; slot--)
+    free_tx_slots.push_back(slot - 1);
+  arm_rx();
+}
+
+IoUringTapInterface::~IoUringTapInterface() { teardown(); }
+
+void IoUringTapInterface::teardown() {
+  if (rx_bufs)
+    std::exchange(rx_bufs, nullptr)->close(ring_fd);
+  if (sqes)
+    munmap(sqes, sqes_size);
+  if (cq_ring && (cq_ring != sq_ring))
+    munmap(cq_ring, cq_ring_size);
+  if (sq_ring)
+    munmap(sq_ring, sq_ring_size);
+  sqes = nullptr;
+  sq_ring = cq_ring = nullptr;
+  if (ring_fd != -1)
+    close(std::exchange(ring_fd, -1));
+  if (tap_fd != -1)
+    close(std::exchange(tap_fd, -1));
+}
+
+void IoUringTapInterface::setup_ring(unsigned entries) {
+  io_uring_params params{};
+  // room for the completions of the writes and of a full buffer ring
+  // the ring starts disabled, so that its single issuer is the thread
+  // enabling it on the first poll rather than the one creating it
+  params.flags = IORING_SETUP_CQSIZE | IORING_SETUP_SINGLE_ISSUER |
+                 IORING_SETUP_DEFER_TASKRUN | IORING_SETUP_R_DISABLED;
+  params.cq_entries = entries + opts.rx_buffers;
+  ring_fd = io_uring_setup(entries, &params);
+  ring_disabled = ring_fd != -1;
+  if ((ring_fd == -1) && (errno == EINVAL)) {
+    // the task-run flags need Linux 6.1
+    params = {};
+    params.flags = IORING_SETUP_CQSIZE;
+    params.cq_entries = entries + opts.rx_buffers;
+    ring_fd = io_uring_setup(entries, &params);
+  }
+  if (ring_fd == -1)
+    throw_errno("io_uring_setup");
+
+  sq_ring_size = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+  cq_ring_size =
+      params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+  if (params.features & IORING_FEAT_SINGLE_MMAP)
+    sq_ring_size = cq_ring_size = std::max(sq_ring_size, cq_ring_size);
+  sq_ring = map_ring(ring_fd, sq_ring_size, IORING_OFF_SQ_RING);
+  cq_ring = (params.features & IORING_FEAT_SINGLE_MMAP)
+                ? sq_ring
+                : map_ring(ring_fd, cq_ring_size, IORING_OFF_CQ_RING);
+  sqes_size = params.sq_entries * sizeof(io_uring_sqe);
+  sqes = static_cast<io_uring_sqe *>(
+      map_ring(ring_fd, sqes_size, IORING_OFF_SQES));
+
+  auto *sq = static_cast<uint8_t *>(sq_ring);
+  sq_head = reinterpret_cast<unsigned *>(sq + params.sq_off.head);
+  sq_tail = reinterpret_cast<unsigned *>(sq + params.sq_off.tail);
+  sq_mask = *reinterpret_cast<unsigned *>(sq + params.sq_off.ring_mask);
+  sq_entries = params.sq_entries;
+  sq_array = reinterpret_cast<unsigned *>(sq + params.sq_off.array);
+  // the entries are submitted in the order they are filled
+  for (unsigned i = 0; i < params.sq_entries; i++)
+    sq_array[i] = i;
+  sq_local_tail = *sq_tail;
+
+  auto *cq = static_cast<uint8_t *>(cq_ring);
+  cq_head = reinterpret_cast<unsigned *>(cq + params.cq_off.head);
+  cq_tail = reinterpret_cast<unsigned *>(cq + params.cq_off.tail);
+  cq_mask = *reinterpret_cast<unsigned *>(cq + params.cq_off.ring_mask);
+  cqes = reinterpret_cast<io_uring_cqe *>(cq + params.cq_off.cqes);
+}
+
+io_uring_sqe *IoUringTapInterface::get_sqe() {
+  if (sq_local_tail - load_acquire(sq_head) >= sq_entries)
+    return nullptr;
+  io_uring_sqe *sqe = &sqes[sq_local_tail & sq_mask];
+  std::memset(sqe, 0, sizeof(*sqe));
+  sq_local_tail++;
+  return sqe;
+}
+
+void IoUringTapInterface::arm_rx() {
+  unsigned target = rx_multishot ? 1 : RX_FALLBACK_READS;
+  while (rx_armed < target) {
+    io_uring_sqe *sqe = get_sqe();
+    if (!sqe)
+      return;
+    sqe->opcode = rx_multishot ? OP_READ_MULTISHOT : uint8_t(IORING_OP_READ);
+    sqe->fd = tap_fd;
+    sqe->flags = IOSQE_BUFFER_SELECT;
+    sqe->buf_group = RX_BGID;
+    sqe->off = uint64_t(-1);
+    sqe->user_data = RX_USER_DATA;
+    rx_armed++;
+  }
+}
+
+void IoUringTapInterface::enter() {
+  unsigned to_submit = sq_local_tail - load_acquire(sq_head);
+  if (!to_submit && (load_acquire(cq_tail) != *cq_head))
+    return;
+  if (ring_disabled &&
+      (io_uring_register(ring_fd, IORING_REGISTER_ENABLE_RINGS, nullptr, 0) !=
+       -1))
+    ring_disabled = false;
+  store_release(sq_tail, sq_local_tail);
+  _stats.enters++;
+  // failures (e.g. EAGAIN or EBUSY with the completion queue overflown) leave
+  // the entries queued for the next attempt
+  io_uring_enter(ring_fd, to_submit, 0, IORING_ENTER_GETEVENTS);
+}
+
+void IoUringTapInterface::enqueue(PBuf packet) {
+  if (free_tx_slots.empty()) {
+    _stats.tx_errors++;
+    return;
+  }
+  uint32_t slot_idx = free_tx_slots.back();
+  TxSlot &slot = tx_slots[slot_idx];
+  size_t n_vnet = opts.vnet_hdr ? 1 : 0;
+  size_t n_segs = packet->to_iovec(std::span(slot.iov).subspan(n_vnet));
+  if (n_segs > slot.iov.size() - n_vnet) {
+    _stats.tx_errors++;
+    return;
+  }
+  if (opts.vnet_hdr) {
+    VnetHdr &vnet = slot.vnet;
+    vnet = {};
+    if (packet->tx_csum_partial) {
+      vnet.flags = VNET_F_NEEDS_CSUM;
+      vnet.csum_start = packet->csum_start;
+      vnet.csum_offset = packet->csum_offset;
+    }
+    if (packet->gso_size) {
+      vnet.gso_type = VNET_GSO_UDP;
+      vnet.gso_size = packet->gso_size;
+      vnet.hdr_len = uint16_t(packet->csum_start + UDP_HDR_SIZE);
+      _stats.tx_gso_packets++;
+    }
+    slot.iov[0] = {&vnet, sizeof(vnet)};
+    n_segs++;
+  }
+  io_uring_sqe *sqe = get_sqe();
+  if (!sqe) {
+    _stats.tx_errors++;
+    return;
+  }
+  free_tx_slots.pop_back();
+  sqe->opcode = IORING_OP_WRITEV;
+  sqe->fd = tap_fd;
+  sqe->addr = reinterpret_cast<uint64_t>(slot.iov.data());
+  sqe->len = uint32_t(n_segs);
+  sqe->off = uint64_t(-1);
+  sqe->user_data = slot_idx;
+  slot.packet = std::move(packet);
+}
+
+void IoUringTapInterface::enqueue_burst(std::span<PBuf> packets) {
+  // the writes are only queued, so there is nothing to batch further
+  for (PBuf &packet : packets)
+    enqueue(std::move(packet));
+}
+
+void IoUringTapInterface::complete_tx(const io_uring_cqe &cqe) {
+  auto slot_idx = uint32_t(cqe.user_data);
+  if (cqe.res < 0)
+    _stats.tx_errors++;
+  else
+    _stats.tx_packets++;
+  tx_slots[slot_idx].packet.reset();
+  free_tx_slots.push_back(slot_idx);
+}
+
+size_t IoUringTapInterface::poll_rx_burst(Stack &stack,
+                                          std::span<PBuf> packets) {
+  // the stack polls again while the bursts are full, so only the first call
+  // of a cycle enters the kernel
+  if (!cycle_entered) {
+    rx_bufs->publish();
+    arm_rx();
+    enter();
+    cycle_entered = true;
+  }
+
+  // the rest of a super-packet goes first
+  size_t n_packets = rx_gso_segments(stack, packets);
+  unsigned head = *cq_head;
+  unsigned tail = load_acquire(cq_tail);
+  for (; head != tail; head++) {
+    const io_uring_cqe &cqe = cqes[head & cq_mask];
+    if (cqe.user_data != RX_USER_DATA) {
+      complete_tx(cqe);
+      continue;
+    }
+    if (n_packets == packets.size())
+      break;
+
+    if (!(cqe.flags & IORING_CQE_F_MORE))
+      rx_armed--;
+    if ((cqe.res == -EINVAL) && rx_multishot) {
+      rx_multishot = false;
+      continue;
+    }
+    bool has_buf = cqe.flags & IORING_CQE_F_BUFFER;
+    auto bid = uint16_t(cqe.flags >> IORING_CQE_BUFFER_SHIFT);
+    if (cqe.res <= 0) {
+      // ENOBUFS ends a multishot read, which is armed again once the buffers
+      // are back
+      _stats.rx_errors++;
+      if (has_buf)
+        rx_bufs->recycle(bid);
+      continue;
+    }
+    _stats.rx_packets++;
+    BufChunk frame = rx_bufs->lend(bid, size_t(cqe.res));
+    if (opts.vnet_hdr)
+      n_packets += rx_vnet_frame(stack, std::move(frame),
+                                 packets.subspan(n_packets));
+    else
+      packets[n_packets++] = stack.pool.get(Buf(std::move(frame)));
+  }
+  store_release(cq_head, head);
+
+  if (n_packets < packets.size())
+    cycle_entered = false;
+  return n_packets;
+}
+
+size_t IoUringTapInterface::rx_vnet_frame(Stack &stack, BufChunk frame,
+                                          std::span<PBuf> packets) {
+  VnetHdr vnet;
+  if (frame.size() < sizeof(vnet)) {
+    _stats.rx_errors++;
+    return 0;
+  }
+  std::memcpy(&vnet, frame.begin(), sizeof(vnet));
+  frame = frame.slice(sizeof(vnet));
+
+  if (vnet.gso_type == VNET_GSO_UDP_L4) {
+    // the UDP header is where the partial checksum starts
+    size_t hdr_len = size_t(vnet.csum_start) + UDP_HDR_SIZE;
+    if (!(vnet.flags & VNET_F_NEEDS_CSUM) || (vnet.gso_size == 0) ||
+        (vnet.csum_start < EthHeader::SIZE) || (hdr_len > frame.size())) {
+      _stats.rx_errors++;
+      return 0;
+    }
+    _stats.rx_gso_packets++;
+    rx_gso.frame = std::move(frame);
+    rx_gso.hdr_len = hdr_len;
+    rx_gso.gso_size = vnet.gso_size;
+    rx_gso.offset = 0;
+    rx_gso.n_segments = 0;
+    return rx_gso_segments(stack, packets);
+  } else if (vnet.gso_type != VNET_GSO_NONE) {
+    // not negotiated
+    _stats.rx_errors++;
+    return 0;
+  }
+
+  PBuf packet = stack.pool.get(Buf(std::move(frame)));
+  packet->rx_csum_valid = vnet.flags & (VNET_F_NEEDS_CSUM |
+                                        VNET_F_DATA_VALID);
+  if (vnet.flags & VNET_F_NEEDS_CSUM) {
+    packet->tx_csum_partial = true;
+    packet->csum_start = vnet.csum_start;
+    packet->csum_offset = vnet.csum_offset;
+  }
+  packets[0] = std::move(packet);
+  return 1;
+}
+
+size_t IoUringTapInterface::rx_gso_segments(Stack &stack,
+                                            std::span<PBuf> packets) {
+  if (rx_gso.frame.is_empty())
+    return 0;
+  const uint8_t *frame = rx_gso.frame.begin();
+  size_t ip_off = EthHeader::SIZE;
+  size_t udp_off = rx_gso.hdr_len - UDP_HDR_SIZE;
+  size_t payload_len = rx_gso.frame.size() - rx_gso.hdr_len;
+  bool is_v4 = (frame[ip_off] >> 4) == 4;
+
+  size_t n_packets = 0;
+  while ((rx_gso.offset < payload_len) && (n_packets < packets.size())) {
+    size_t seg_len = std::min(rx_gso.gso_size, payload_len - rx_gso.offset);
+    // the headers are copied and adjusted for each datagram, while the
+    // payload references the super-packet; the UDP checksum is left partial
+    PBuf segment = stack.pool.get(rx_gso.hdr_len);
+    uint8_t *hdr = segment->begin().contiguous().data();
+    std::memcpy(hdr, frame, rx_gso.hdr_len);
+    auto udp_len = uint16_t(UDP_HDR_SIZE + seg_len);
+    store_be16(hdr + udp_off + 4, udp_len);
+    // the partial sum covers the length of the super-packet, replaced by the
+    // datagram's
+    uint16_t udp_csum;
+    std::memcpy(&udp_csum, hdr + udp_off + 6, sizeof(udp_csum));
+    udp_csum = ~csum_replace(uint16_t(~udp_csum), {frame + udp_off + 4, 2},
+                             {hdr + udp_off + 4, 2});
+    std::memcpy(hdr + udp_off + 6, &udp_csum, sizeof(udp_csum));
+    if (is_v4) {
+      uint8_t *ip_hdr = hdr + ip_off;
+      store_be16(ip_hdr + 2, uint16_t(udp_off - ip_off + udp_len));
+      store_be16(ip_hdr + 4,
+                 uint16_t(load_be16(frame + ip_off + 4) + rx_gso.n_segments));
+      ip_hdr[10] = ip_hdr[11] = 0;
+      uint16_t hdr_csum =
+          ~csum_fold(csum_partial({ip_hdr, udp_off - ip_off}));
+      std::memcpy(ip_hdr + 10, &hdr_csum, sizeof(hdr_csum));
+    } else {
+      // the payload length excludes the fixed IPv6 header
+      store_be16(hdr + ip_off + 4, uint16_t(udp_off - ip_off - 40 + udp_len));
+    }
+    segment->insert_chunk(
+        rx_gso.frame.slice(rx_gso.hdr_len + rx_gso.offset, seg_len),
+        rx_gso.hdr_len);
+    segment->rx_csum_valid = true;
+    segment->tx_csum_partial = true;
+    segment->csum_start = uint16_t(udp_off);
+    segment->csum_offset = 6;
+    packets[n_packets++] = std::move(segment);
+    rx_gso.offset += seg_len;
+    rx_gso.n_segments++;
+  }
+  if (rx_gso.offset == payload_len)
+    rx_gso.frame = BufChunk();
+  return n_packets;
+}
+
+void IoUringTapInterface::poll_tx(Stack &) {
+  // the writes queued since the cycle entered the kernel (e.g. the replies to
+  // the received frames) are submitted right away, while their completions
+  // are collected by the next [poll_rx_burst]
+  if (sq_local_tail != load_acquire(sq_head))
+    enter();
+  rx_bufs->publish();
+}
+} // namespace jay
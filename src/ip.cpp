@@ -12,7 +12,8 @@ namespace jay::ip {
 void IPStack::ip_input(PBuf packet, IPVersion version) {
   IPHeader ip_hdr =
       packet->is_ip() ? packet->ip()
-                      : UNWRAP_RETURN(packet->read_net_hdr<IPHeader>(version));
+                      : UNWRAP_RETURN(packet->read_net_hdr<IPHeader>(
+                            version, !packet->rx_csum_valid));
   IPAddr dst_addr = ip_hdr.dst_addr();
 
   auto [local_ip, local_ip_state, match_len] = ips.match_longest(dst_addr);
@@ -34,11 +35,18 @@ void IPStack::ip_input(PBuf packet, IPVersion version) {
   }
 }
 
+void IPStack::ip_input(std::span<PBuf> packets, IPVersion version) {
+  for (PBuf &packet : packets)
+    ip_input(std::move(packet), version);
+}
+
 void IPStack::ip_forward(PBuf packet) {
   packet->forwarded = true;
+  // the TTL and the lengths are rewritten in place on output
+  packet->unshare_net_hdr();
   if (packet->ip().ttl() == 0) {
     output(PBuf::icmp_for<ICMPTimeExceededMessage>(
-        packet->ip().src_addr(), nullptr, TimeExceededType::HOP_LIMIT,
+        pool().get(), packet->ip().src_addr(), nullptr, TimeExceededType::HOP_LIMIT,
         &packet->buf()));
     return;
   }
@@ -144,17 +152,57 @@ void IPStack::igmp_deliver_query(Interface *iface, IPv4Addr group_addr,
 
 void IPStack::udp_deliver(PBuf packet) {
   UNWRAP_RETURN(packet->read_tspt_hdr<udp::UDPHeader>());
-  _sock_table.deliver(std::move(packet));
+  Socket *sock = _sock_table.find(packet);
+  if (!sock)
+    return;
+
+  // datagrams of established flows are delivered regardless of the memory
+  // pressure; the charge only lasts for the delivery (see
+  // [MemSubsystem::SOCKET])
+  MemAccounting &accounting = stack.accounting;
+  size_t packet_bytes = packet->total_size();
+  MemPriority priority = sock->is_connected() ? MemPriority::ESTABLISHED
+                                              : MemPriority::NEW_FLOW;
+  if (!accounting.charge(MemSubsystem::SOCKET, packet_bytes, priority))
+    return;
+  if (stack.compact_policy.before_deliver)
+    stack.compact_policy.apply(*packet);
+  sock->deliver(std::move(packet));
+  accounting.release(MemSubsystem::SOCKET, packet_bytes);
 }
 
 void IPStack::icmp_deliver_msg(PBuf packet, ICMPEchoRequestMessage msg) {
+  // the reply is built in place of the request headers, so save what we need
+  // from them before they get overwritten
+  IPAddr req_src = packet->ip().src_addr();
+  IPAddr req_dst = packet->ip().dst_addr();
+  uint16_t ident = msg.ident();
+  uint16_t seq_num = msg.seq_num();
+  // the reply differs from the request only in the message type and the
+  // order of the addresses in the ICMPv6 pseudo-header, which does not change
+  // its sum, so its checksum is patched instead of recomputed -- provided it
+  // was verified by icmp_deliver: a request reported valid by the device (or
+  // looped back) may carry just a partial checksum, or none at all
+  ICMPHeader req_hdr = packet->icmp();
+  uint16_t req_csum = req_hdr.checksum();
+  std::array<uint8_t, 2> req_type;
+  std::ranges::copy(req_hdr.cursor().span().first(2), req_type.begin());
+  bool req_csum_verified = !packet->rx_csum_valid;
+  packet->reset_metadata();
+
   ICMPEchoReplyMessage reply_msg;
   PBuf reply_packet = PBuf::icmp_for<ICMPEchoReplyMessage>(
-      packet->ip().src_addr(), &reply_msg, 0, &packet->buf());
-  reply_packet->ip().src_addr() = IPAddr(packet->ip().dst_addr());
-  reply_msg.ident() = uint16_t(msg.ident());
-  reply_msg.seq_num() = uint16_t(msg.seq_num());
-  reply_packet->iface = packet->iface;
+      std::move(packet), req_src, &reply_msg, 0);
+  reply_packet->ip().src_addr() = req_dst;
+  reply_msg.ident() = ident;
+  reply_msg.seq_num() = seq_num;
+
+  if (req_csum_verified) {
+    ICMPHeader reply_hdr = reply_packet->icmp();
+    reply_hdr.checksum() =
+        csum_replace(req_csum, req_type, reply_hdr.cursor().span().first(2));
+    reply_packet->tspt_csum_valid = true;
+  }
   output(std::move(reply_packet));
 }
 
@@ -227,8 +275,7 @@ void IPStack::icmp_deliver_msg(PBuf packet, NDPNeighborSolicitation msg) {
   bool src_is_unspecified = IPAddr(packet->ip().src_addr()).is_any();
   if (src_is_unspecified && src_haddr.has_value())
     return;
-  PBuf reply_packet;
-  reply_packet->reserve_headers();
+  PBuf reply_packet = pool().get();
   ICMPHeader icmp_hdr =
       reply_packet
           ->construct_tspt_hdr<ICMPHeader>(IPVersion::V6, adv_msg, 0,
@@ -292,8 +339,11 @@ void IPStack::icmp_deliver(PBuf packet, IPVersion version) {
   ICMPHeader icmp_hdr =
       UNWRAP_RETURN(packet->read_tspt_hdr<ICMPHeader>(version));
   packet->unmask(icmp_hdr.size());
-  IPProto proto = (version == IPVersion::V4) ? IPProto::ICMP : IPProto::ICMPv6;
-  if (inet_csum(*packet, packet->ip().pseudohdr_sum(proto)) != 0x0000)
+  // only ICMPv6 includes the pseudo-header in the checksum
+  uint32_t initial_sum = (version == IPVersion::V4)
+                             ? 0
+                             : packet->ip().pseudohdr_sum(IPProto::ICMPv6);
+  if (!packet->rx_csum_valid && (inet_csum(*packet, initial_sum) != 0x0000))
     return;
   packet->mask(icmp_hdr.size());
 
@@ -312,44 +362,77 @@ void IPStack::reassemble_timeout(ReassKey reass_key, Reassembly &reass) {
 
   const auto &[src_ip, dst_ip, ident] = reass_key;
   PBuf reply_packet = PBuf::icmp_for<ICMPTimeExceededMessage>(
-      src_ip, nullptr, TimeExceededType::REASSEMBLY, &reass_buf);
+      pool().get(), src_ip, nullptr, TimeExceededType::REASSEMBLY, &reass_buf);
   reply_packet->ip().src_addr() = dst_ip;
-  reass_queue.erase(reass_key);
+  reassemble_drop(reass_key);
   output(std::move(reply_packet));
 }
 
+void IPStack::reassemble_drop(ReassKey reass_key) {
+  auto reass_it = reass_queue.find(reass_key);
+  if (reass_it == reass_queue.end())
+    return;
+  stack.accounting.release(MemSubsystem::REASSEMBLY,
+                           reass_it->second.charged_bytes);
+  reass_queue.erase(reass_it);
+}
+
 void IPStack::ip_reassemble_single(PBuf packet, IPFragData frag_data) {
   ReassKey reass_key{packet->ip().src_addr(), packet->ip().dst_addr(),
                      frag_data.identification()};
-  Reassembly &reass = reass_queue[reass_key];
-  if (reass.packet->size() == 0) {
-    reass.timer = timers.create(reassembly_timeout, [this, reass_key](Timer *) {
-      reassemble_timeout(reass_key, reass_queue[reass_key]);
-    });
-    reass.packet->reserve_headers();
-    reass.packet->construct_net_hdr<IPHeader>(packet->ip().version(),
-                                              packet->ip());
+  MemAccounting &accounting = stack.accounting;
+  size_t frag_bytes = packet->total_size();
+  auto reass_it = reass_queue.find(reass_key);
+  if (reass_it == reass_queue.end()) {
+    // new reassemblies are the first work to be shed under memory pressure
+    if (!accounting.charge(MemSubsystem::REASSEMBLY, frag_bytes,
+                           MemPriority::SPECULATIVE))
+      return;
+    reass_it = reass_queue
+                   .emplace(reass_key,
+                            Reassembly{pool().get(), nullptr, frag_bytes})
+                   .first;
+    reass_it->second.timer =
+        timers.create(reassembly_timeout, [this, reass_key](Timer *) {
+          reassemble_timeout(reass_key, reass_queue[reass_key]);
+        });
+    IPHeader base_hdr = packet->ip();
+    reass_it->second.packet->construct_net_hdr<IPHeader>(base_hdr.version(),
+                                                         base_hdr);
+  } else {
+    if (!accounting.charge(MemSubsystem::REASSEMBLY, frag_bytes,
+                           MemPriority::NEW_FLOW, 0)) {
+      reassemble_drop(reass_key);
+      return;
+    }
+    reass_it->second.charged_bytes += frag_bytes;
   }
+  Reassembly &reass = reass_it->second;
 
   if (!frag_data.more_frags()) {
     if (packet->has_last_fragment) {
-      reass_queue.erase(reass_key);
+      reassemble_drop(reass_key);
       return;
     }
     packet->has_last_fragment = true;
   }
 
   if (reass.packet->insert(*packet, frag_data.frag_offset()).has_error()) {
-    reass_queue.erase(reass_key);
+    reassemble_drop(reass_key);
     return;
   }
 
   if (reass.packet->is_complete() && packet->has_last_fragment) {
     ip_input(std::move(reass.packet), packet->ip().version());
-    reass_queue.erase(reass_key);
+    reassemble_drop(reass_key);
   }
 }
 
+void IPStack::arp_input(std::span<PBuf> packets) {
+  for (PBuf &packet : packets)
+    arp_input(std::move(packet));
+}
+
 void IPStack::arp_input(PBuf packet) {
   ARPHeader arp_hdr = UNWRAP_RETURN(packet->read_net_hdr<ARPHeader>());
 
@@ -361,8 +444,7 @@ void IPStack::arp_input(PBuf packet) {
     if (packet->iface != tgt_ip_state->iface)
       return;
 
-    PBuf reply_packet;
-    reply_packet->reserve_headers();
+    PBuf reply_packet = pool().get();
     reply_packet->iface = packet->iface;
     ARPHeader reply_arp_hdr =
         reply_packet->construct_net_hdr<ARPHeader>().value();
@@ -440,6 +522,11 @@ void IPStack::ip_output_resolve(PBuf packet) {
       dst->src_iaddr = src_addr;
   }
 
+  if (packet->local) {
+    ip_loopback(std::move(packet));
+    return;
+  }
+
   uint16_t if_mtu = packet->iface->mtu();
   if (packet->size() <= if_mtu) {
     ip_output_final(std::move(packet));
@@ -457,24 +544,41 @@ void IPStack::ip_output_resolve(PBuf packet) {
   } else if (packet->forwarded) {
     if (packet->is_icmp())
       return;
-    output(PBuf::icmp_for<ICMPPacketTooBig>(packet->ip().src_addr(), nullptr, 0,
+    output(PBuf::icmp_for<ICMPPacketTooBig>(pool().get(),
+                                            packet->ip().src_addr(), nullptr, 0,
                                             &packet->buf()));
     return;
   }
+
+  // UDP datagrams are left to interfaces able to fragment them themselves;
+  // the fragment payload is a multiple of 8 bytes, leaving room for the
+  // fragment header in IPv6
+  size_t ip_hdr_size = packet->ip().size();
+  if (packet->is_udp() &&
+      (ip_hdr_size + packet->size() <= packet->iface->gso_max_size())) {
+    size_t frag_hdr_size =
+        packet->ip().is_v4() ? 0 : IPv6FragData::size_hint();
+    packet->gso_size = (if_mtu - ip_hdr_size - frag_hdr_size) & ~size_t(7);
+    ip_output_final(std::move(packet));
+    return;
+  }
   ip_output_fragment(std::move(packet), if_mtu);
 }
 
 void IPStack::ip_output_fragment(PBuf packet, size_t if_mtu) {
+  // the fragments can't carry a partial checksum of the whole payload
+  if (packet->tx_csum_partial)
+    packet->complete_tx_csum();
   size_t frag_offset = 0;
   while (packet->size() > 0) {
-    PBuf fragment;
-    fragment->reserve_headers();
+    PBuf fragment = pool().get();
     fragment->iface = packet->iface;
     fragment->nh_haddr = packet->nh_haddr;
     fragment->nh_iaddr = packet->nh_iaddr;
 
     IPFragData frag_data;
-    fragment->construct_net_hdr<IPHeader>(packet->ip().version(), packet->ip(),
+    IPHeader base_hdr = packet->ip();
+    fragment->construct_net_hdr<IPHeader>(base_hdr.version(), base_hdr,
                                           &frag_data);
 
     size_t frag_payload_size = if_mtu - fragment->ip().size();
@@ -494,55 +598,110 @@ void IPStack::ip_output_fragment(PBuf packet, size_t if_mtu) {
 }
 
 void IPStack::ip_output_final(PBuf packet) {
+  // the header checksum of forwarded packets has been verified on input, so
+  // it is patched for the rewritten fields instead of being recomputed
+  bool patch_v4_csum = packet->forwarded && packet->ip().is_v4();
   if (packet->ip().is_v4()) {
     auto v4_hdr = packet->ip().v4();
-    v4_hdr.total_len() = packet->size() + v4_hdr.size();
+    uint16_t total_len = packet->size() + v4_hdr.size();
+    if (patch_v4_csum)
+      v4_hdr.update_field(v4_hdr.total_len(), total_len, v4_hdr.hdr_csum());
+    else
+      v4_hdr.total_len() = total_len;
   } else {
     auto v6_hdr = packet->ip().v6();
     v6_hdr.payload_len() = v6_hdr.exthdr_size() + packet->size();
   }
 
-  std::visit(
-      [&](auto tspt_hdr) {
-        if constexpr (std::is_same_v<decltype(tspt_hdr), udp::UDPHeader>) {
-          tspt_hdr.checksum() = 0;
-          tspt_hdr.checksum() = inet_csum(
-              packet->buf(), packet->ip().pseudohdr_sum(IPProto::UDP));
-        } else if constexpr (std::is_same_v<decltype(tspt_hdr), ICMPHeader>) {
-          tspt_hdr.checksum() = 0;
-          if (tspt_hdr.is_v4())
-            tspt_hdr.checksum() = inet_csum(packet->buf());
-          else
-            tspt_hdr.checksum() = inet_csum(
-                packet->buf(), packet->ip().pseudohdr_sum(IPProto::ICMPv6));
-        } else if constexpr (std::is_same_v<decltype(tspt_hdr), IGMPHeader>) {
-          tspt_hdr.checksum() = 0;
-          tspt_hdr.checksum() = inet_csum(packet->buf());
-        }
-      },
-      packet->tspt_hdr);
-
-  if (packet->ip().ttl() == 0)
-    packet->ip().ttl() = packet->iface ? packet->iface->hop_limit : 64;
+  // the transport checksum is left to the interface if it can compute it
+  bool offload_csum = packet->iface && packet->iface->tx_csum_offload();
+  auto fill_csum = [&](auto tspt_hdr, uint32_t init_sum) {
+    tspt_hdr.checksum() = 0;
+    if (offload_csum) {
+      tspt_hdr.checksum() = csum_fold(init_sum);
+      packet->csum_offset = tspt_hdr.field_offset(tspt_hdr.checksum());
+      packet->tx_csum_partial = true;
+    } else {
+      tspt_hdr.checksum() = packet->tspt_csum(tspt_hdr.size(), init_sum);
+    }
+  };
+  if (packet->tspt_csum_valid) {
+    // already up to date
+  } else if (packet->is_udp()) {
+    fill_csum(packet->udp(), packet->ip().pseudohdr_sum(IPProto::UDP));
+  } else if (packet->is_icmp()) {
+    auto icmp_hdr = packet->icmp();
+    if (icmp_hdr.is_v4())
+      fill_csum(icmp_hdr, 0);
+    else
+      fill_csum(icmp_hdr, packet->ip().pseudohdr_sum(IPProto::ICMPv6));
+  } else if (packet->is_igmp()) {
+    fill_csum(packet->igmp(), 0);
+  }
+
+  uint8_t ttl = packet->ip().ttl();
+  if (ttl == 0)
+    ttl = packet->iface ? packet->iface->hop_limit : 64;
   else if (packet->forwarded)
-    packet->ip().ttl() = packet->ip().ttl() - 1;
+    ttl -= 1;
+  if (patch_v4_csum) {
+    auto v4_hdr = packet->ip().v4();
+    v4_hdr.update_field(v4_hdr.ttl(), ttl, v4_hdr.hdr_csum());
+  } else {
+    packet->ip().ttl() = ttl;
+  }
+
+  // a partial checksum received from a local peer (see
+  // [PBufStruct::rx_csum_valid]) is completed here if the interface can't
+  if (packet->tx_csum_partial && !offload_csum)
+    packet->complete_tx_csum();
 
   packet->unmask(packet->ip().size());
-  if (packet->ip().is_v4()) {
+  if (packet->ip().is_v4() && !patch_v4_csum) {
     auto v4_hdr = packet->ip().v4();
     v4_hdr.hdr_csum() = 0;
     v4_hdr.hdr_csum() = inet_csum(v4_hdr.cursor().span());
   }
 
-  if (packet->local) {
-    IPVersion version = packet->nh_iaddr.value().version();
-    ip_input(std::move(packet), version);
+  packet->construct_link_hdr<EthHeader>();
+  packet->eth().ether_type() =
+      packet->ip().is_v4() ? EtherType::IPV4 : EtherType::IPV6;
+  packet->eth().dst_haddr() = packet->nh_haddr.value();
+  if ((packet->tx_csum_partial && !packet->forwarded) || packet->gso_size)
+    packet->csum_start = packet->eth().size() + packet->ip().size();
+  stack.output(std::move(packet));
+}
+
+void IPStack::ip_loopback(PBuf packet) {
+  // the packet can't be corrupted on the way, so its checksums are neither
+  // computed nor verified, and it isn't fragmented; the headers are left as
+  // constructed, with the transport header at the masked position, as if
+  // just parsed by ip_input
+  if (packet->ip().is_v4()) {
+    auto v4_hdr = packet->ip().v4();
+    v4_hdr.total_len() = packet->size() + v4_hdr.size();
+  } else {
+    auto v6_hdr = packet->ip().v6();
+    v6_hdr.payload_len() = v6_hdr.exthdr_size() + packet->size();
+  }
+  if (packet->ip().ttl() == 0)
+    packet->ip().ttl() = packet->iface ? packet->iface->hop_limit : 64;
+  packet->rx_csum_valid = true;
+
+  // packets of other protocols are delivered by the protocol number of their
+  // header, as on input
+  if (packet->is_udp()) {
+    ip_deliver(std::move(packet), IPProto::UDP);
+  } else if (packet->is_icmp()) {
+    IPProto proto = packet->icmp().is_v4() ? IPProto::ICMP : IPProto::ICMPv6;
+    ip_deliver(std::move(packet), proto);
+  } else if (packet->is_igmp()) {
+    ip_deliver(std::move(packet), IPProto::IGMP);
+  } else if (packet->ip().is_v4()) {
+    IPProto proto = packet->ip().v4().proto();
+    ip_deliver(std::move(packet), proto);
   } else {
-    packet->construct_link_hdr<EthHeader>();
-    packet->eth().ether_type() =
-        packet->ip().is_v4() ? EtherType::IPV4 : EtherType::IPV6;
-    packet->eth().dst_haddr() = packet->nh_haddr.value();
-    stack.output(std::move(packet));
+    ip_input_v6(std::move(packet));
   }
 }
 
@@ -558,8 +717,7 @@ void IPStack::output(PBuf packet) {
 void IPStack::solicit_haddr_v4(Interface *iface, IPv4Addr tgt_iaddr,
                                IPv4Addr sdr_iaddr,
                                std::optional<HWAddr> thaddr_hint) {
-  PBuf solicit_packet;
-  solicit_packet->reserve_headers();
+  PBuf solicit_packet = pool().get();
   solicit_packet->iface = iface;
   ARPHeader arp_hdr = solicit_packet->construct_net_hdr<ARPHeader>().value();
   arp_hdr.op() = ARPOp::REQUEST;
@@ -581,8 +739,7 @@ void IPStack::solicit_haddr_v6(Interface *iface, IPAddr tgt_iaddr,
     dst_addr = IPAddr::solicited_node(tgt_iaddr);
 
   NDPNeighborSolicitation solicit_msg;
-  PBuf solicit_packet;
-  solicit_packet->reserve_headers();
+  PBuf solicit_packet = pool().get();
 
   std::optional<HWAddr> source_haddr;
   if (!siaddr.is_any())
@@ -622,11 +779,12 @@ void IPStack::icmp_notify_unreachable(PBuf packet, UnreachableReason reason) {
   if (packet->is_icmp())
     return;
   output(PBuf::icmp_for<ICMPDestinationUnreachableMessage>(
-      packet->ip().src_addr(), nullptr, reason, &packet->buf()));
+      pool().get(), packet->ip().src_addr(), nullptr, reason, &packet->buf()));
 }
 
 void IPStack::setup_interface(Interface *iface) {
   using namespace std::placeholders;
+  iface->neighbours.set_accounting(&stack.accounting);
   iface->neighbours.set_callbacks(
       std::bind(&IPStack::solicit_haddr, this, _1, _2, _3, _4),
       [this](IPAddr, Neighbour &neigh) {
@@ -717,9 +875,8 @@ void IPStack::mcast_leave(Interface *iface, IPAddr group_addr) {
 
 void IPStack::igmp_send_report(IGMPMessageType msg_type, Interface *iface,
                                IPv4Addr group_addr) {
-  PBuf report_packet;
+  PBuf report_packet = pool().get();
   report_packet->iface = iface;
-  report_packet->reserve_headers();
   auto igmp_hdr = report_packet->construct_tspt_hdr<IGMPHeader>().value();
   igmp_hdr.type() = msg_type;
   igmp_hdr.group_addr() = group_addr;
@@ -744,14 +901,16 @@ void IPStack::igmp_send_report(IGMPMessageType msg_type, Interface *iface,
 }
 
 void IPStack::mld_send_report(Interface *iface, IPAddr mcast_addr, bool leave) {
-  PBuf report_packet;
+  PBuf report_packet = pool().get();
   if (leave) {
     MLDDone leave_msg;
-    report_packet = PBuf::icmp_for(IPAddr::all_routers(), &leave_msg);
+    report_packet = PBuf::icmp_for(std::move(report_packet),
+                                   IPAddr::all_routers(), &leave_msg);
     leave_msg.mcast_addr() = mcast_addr;
   } else {
     MLDReport report_msg;
-    report_packet = PBuf::icmp_for(mcast_addr, &report_msg);
+    report_packet =
+        PBuf::icmp_for(std::move(report_packet), mcast_addr, &report_msg);
     report_msg.mcast_addr() = mcast_addr;
   }
   report_packet->iface = iface;
@@ -783,6 +942,8 @@ void IPStack::assign_ip(Interface *iface, IPAddr address, uint8_t prefix_len) {
   }
 }
 
+PBufPool &IPStack::pool() { return stack.pool; }
+
 void IPStack::poll() {
   poll_timers();
   for (const auto &interface : stack.interfaces()) {
@@ -4,9 +4,10 @@
 
 namespace jay::ip {
 const size_t IPv4Header::MIN_SIZE;
-Result<IPv4Header, IPv4Header::ErrorType> IPv4Header::read(StructWriter cur) {
+Result<IPv4Header, IPv4Header::ErrorType> IPv4Header::read(StructWriter cur,
+                                                            bool verify_csum) {
   IPv4Header hdr = UNWRAP_PROPAGATE(BufStruct::read(cur));
-  if (inet_csum(hdr.cur.span()) != 0)
+  if (verify_csum && (inet_csum(hdr.cur.span()) != 0))
     return ResultError(IPHeaderError::CHECKSUM_ERROR);
   return hdr;
 }
@@ -0,0 +1,95 @@
+#include "jay/buf/mem_resource.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <new>
+#include <sys/mman.h>
+
+namespace jay {
+PacketMemoryResource::PacketMemoryResource(Options opts) : opts(opts) {
+  if (this->opts.huge_pages)
+    this->opts.region_size = (this->opts.region_size + HUGE_PAGE_SIZE - 1) &
+                             ~(HUGE_PAGE_SIZE - 1);
+}
+
+PacketMemoryResource::~PacketMemoryResource() {
+  for (const Region &region : regions)
+    munmap(region.base, region.size);
+}
+
+size_t PacketMemoryResource::class_index(size_t bytes) {
+  for (size_t i = 0; i < SIZE_CLASSES.size(); i++) {
+    if (bytes <= SIZE_CLASSES[i] + SLOT_OVERHEAD)
+      return i;
+  }
+  return SIZE_CLASSES.size();
+}
+
+void *PacketMemoryResource::map_region(size_t size) {
+  if (opts.huge_pages) {
+    void *base = mmap(nullptr, size, PROT_READ | PROT_WRITE,
+                      MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+    if (base != MAP_FAILED) {
+      _stats.huge_regions += 1;
+      return base;
+    }
+  }
+
+  void *base = mmap(nullptr, size, PROT_READ | PROT_WRITE,
+                    MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  if (base == MAP_FAILED)
+    throw std::bad_alloc();
+  if (opts.huge_pages)
+    madvise(base, size, MADV_HUGEPAGE); // best-effort, ignore failures
+  return base;
+}
+
+void PacketMemoryResource::refill(size_t class_idx) {
+  size_t slot = slot_size(SIZE_CLASSES[class_idx]);
+  size_t region_size = std::max(opts.region_size, slot);
+  auto *base = static_cast<uint8_t *>(map_region(region_size));
+  regions.push_back({base, region_size});
+  _stats.regions += 1;
+
+  // thread the slots onto the free list back-to-front, so that they are handed
+  // out in the address order
+  FreeSlot *head = free_slots[class_idx];
+  for (size_t off = (region_size / slot) * slot; off > 0; off -= slot) {
+    auto *free_slot = reinterpret_cast<FreeSlot *>(base + off - slot);
+    free_slot->next = head;
+    head = free_slot;
+  }
+  free_slots[class_idx] = head;
+}
+
+void *PacketMemoryResource::do_allocate(size_t bytes, size_t alignment) {
+  size_t class_idx = class_index(bytes);
+  if ((class_idx == SIZE_CLASSES.size()) || (alignment > SLOT_ALIGN)) {
+    _stats.upstream_allocs += 1;
+    _stats.upstream_bytes += bytes;
+    return opts.upstream->allocate(bytes, alignment);
+  }
+
+  if (free_slots[class_idx] == nullptr)
+    refill(class_idx);
+  FreeSlot *slot = free_slots[class_idx];
+  free_slots[class_idx] = slot->next;
+  _stats.in_use[class_idx] += 1;
+  return slot;
+}
+
+void PacketMemoryResource::do_deallocate(void *p, size_t bytes,
+                                         size_t alignment) {
+  size_t class_idx = class_index(bytes);
+  if ((class_idx == SIZE_CLASSES.size()) || (alignment > SLOT_ALIGN)) {
+    _stats.upstream_bytes -= bytes;
+    opts.upstream->deallocate(p, bytes, alignment);
+    return;
+  }
+
+  auto *slot = static_cast<FreeSlot *>(p);
+  slot->next = free_slots[class_idx];
+  free_slots[class_idx] = slot;
+  _stats.in_use[class_idx] -= 1;
+}
+} // namespace jay
@@ -0,0 +1,38 @@
+#include "jay/memory_link.h"
+
+namespace jay {
+MemoryPort::MemoryPort(HWAddr hwaddr, uint16_t mtu, std::shared_ptr<Ring> rx,
+                       std::shared_ptr<Ring> tx, bool csum_offload)
+    : _hwaddr(hwaddr), _mtu(mtu), rx(std::move(rx)), tx(std::move(tx)),
+      csum_offload(csum_offload) {}
+
+void MemoryPort::enqueue(PBuf packet) {
+  if (tx->push(std::move(packet)))
+    _stats.tx_packets++;
+  else
+    _stats.tx_drops++;
+}
+
+size_t MemoryPort::poll_rx_burst(Stack &, std::span<PBuf> packets) {
+  size_t n_packets = rx->pop_burst(packets);
+  for (PBuf &packet : packets.first(n_packets)) {
+    // the frame arrives as the peer output it, with its headers parsed and
+    // its transport checksum possibly left partial
+    bool csum_partial = packet->tx_csum_partial;
+    packet->reset_metadata();
+    packet->rx_csum_valid = csum_offload;
+    packet->tx_csum_partial = csum_partial;
+  }
+  _stats.rx_packets += n_packets;
+  return n_packets;
+}
+
+MemoryLink::MemoryLink(HWAddr a_hwaddr, HWAddr b_hwaddr, Options opts) {
+  auto a_to_b = std::make_shared<MemoryPort::Ring>(opts.ring_size);
+  auto b_to_a = std::make_shared<MemoryPort::Ring>(opts.ring_size);
+  _a = std::make_shared<MemoryPort>(a_hwaddr, opts.mtu, b_to_a, a_to_b,
+                                    opts.csum_offload);
+  _b = std::make_shared<MemoryPort>(b_hwaddr, opts.mtu, a_to_b, b_to_a,
+                                    opts.csum_offload);
+}
+} // namespace jay
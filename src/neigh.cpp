@@ -14,7 +14,7 @@ std::optional<PBuf> NeighCache::resolve(PBuf packet) {
   switch (neigh.state) {
   case NeighState::INCOMPLETE:
     start_solicit(iface, tgt_iaddr, src_addr, std::nullopt);
-    neigh.queue.emplace_back(std::move(packet));
+    enqueue(neigh, std::move(packet));
     return std::nullopt;
   case NeighState::STALE:
     neigh.state = NeighState::DELAY;
@@ -31,6 +31,31 @@ std::optional<PBuf> NeighCache::resolve(PBuf packet) {
   }
 }
 
+void NeighCache::enqueue(Neighbour &neigh, PBuf packet) {
+  size_t packet_bytes = packet->total_size();
+  // the oldest packet only makes room for a new one that is admitted
+  if (accounting && !accounting->charge(MemSubsystem::NEIGH_QUEUE,
+                                        packet_bytes,
+                                        MemPriority::SPECULATIVE))
+    return;
+  if (!neigh.queue.empty() && (neigh.queue.size() >= max_queue_len)) {
+    size_t oldest_bytes = neigh.queue.front()->total_size();
+    if (accounting)
+      accounting->release(MemSubsystem::NEIGH_QUEUE, oldest_bytes);
+    neigh.queued_bytes -= oldest_bytes;
+    neigh.queue.pop_front();
+  }
+  neigh.queued_bytes += packet_bytes;
+  neigh.queue.emplace_back(std::move(packet));
+}
+
+void NeighCache::release_queue(Neighbour &neigh) {
+  if (accounting)
+    accounting->release(MemSubsystem::NEIGH_QUEUE, neigh.queued_bytes,
+                        neigh.queue.size());
+  neigh.queued_bytes = 0;
+}
+
 void NeighCache::start_solicit(Interface *iface, ip::IPAddr tgt_iaddr,
                                ip::IPAddr siaddr,
                                std::optional<HWAddr> thaddr_hint) {
@@ -57,6 +82,7 @@ void NeighCache::notify_unreachable(ip::IPAddr neigh_iaddr) {
   auto neigh_it = cache.find(neigh_iaddr);
   if (neigh_it == cache.end())
     return;
+  release_queue(neigh_it->second);
   unreachable_fn(neigh_iaddr, neigh_it->second);
   cache.erase(neigh_it);
 }
@@ -98,6 +124,7 @@ std::optional<std::list<PBuf>> NeighCache::process_adv(ip::IPAddr tgt_iaddr, std
     else
       neigh.state = NeighState::STALE;
 
+    release_queue(neigh);
     return std::move(neigh.queue);
   } else {
     bool haddr_differs = tgt_haddr.has_value() && (neigh.haddr != tgt_haddr);
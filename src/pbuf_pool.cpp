@@ -0,0 +1,83 @@
+#include "jay/pbuf_pool.h"
+
+namespace jay {
+void PBufDeleter::operator()(PBufStruct *packet) const {
+  if (pool)
+    pool->release(packet);
+  else
+    delete packet;
+}
+
+PBufPool::~PBufPool() {
+  for (Entry *entry : free_list)
+    delete entry;
+}
+
+PBufPool::Entry *PBufPool::acquire() {
+  if (free_list.empty()) {
+    _stats.misses += 1;
+    return new Entry(chunk_size, mem);
+  }
+  _stats.hits += 1;
+  Entry *entry = free_list.back();
+  free_list.pop_back();
+  return entry;
+}
+
+PBuf PBufPool::get(size_t payload_size) {
+  if (_room.headroom + payload_size > chunk_size) {
+    _stats.misses += 1;
+    return PBuf(payload_size, _room, Buf::allocator_type(mem));
+  }
+
+  Entry *entry = acquire();
+  entry->buf() = Buf(entry->backing.slice(0, _room.headroom + payload_size),
+                     Buf::allocator_type(mem));
+  entry->headroom = _room.headroom;
+  entry->mask(_room.headroom);
+  return PBuf(entry, this);
+}
+
+PBuf PBufPool::get(const Buf &payload) {
+  Entry *entry = acquire();
+  entry->buf() = payload;
+  entry->headroom = _room.headroom;
+  entry->reserve_before(_room.headroom,
+                        entry->backing.slice(0, _room.headroom));
+  return PBuf(entry, this);
+}
+
+PBuf PBufPool::copy(const Buf &payload) {
+  PBuf packet = get(payload.size());
+  // an empty payload leaves no chunk to copy into
+  if (payload.size() == 0) {
+    packet->payload_csum = 0;
+    packet->payload_csum_valid = true;
+    return packet;
+  }
+  uint64_t sum = payload.copy_csum(packet->begin().contiguous().data());
+  packet->payload_csum = csum_fold(sum);
+  packet->payload_csum_valid = true;
+  return packet;
+}
+
+void PBufPool::reserve(size_t count) {
+  while (free_list.size() < std::min(count, capacity))
+    free_list.push_back(new Entry(chunk_size, mem));
+}
+
+void PBufPool::release(PBufStruct *packet) {
+  Entry *entry = static_cast<Entry *>(packet);
+  static_cast<PBufStruct &>(*entry) = PBufStruct();
+  if (free_list.size() >= capacity) {
+    delete entry;
+    return;
+  }
+
+  if (entry->backing.has_unpinned_refs()) {
+    entry->replace_backing(chunk_size, mem);
+    _stats.escaped += 1;
+  }
+  free_list.push_back(entry);
+}
+} // namespace jay
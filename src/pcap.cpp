@@ -0,0 +1,288 @@
+#include "jay/pcap.h"
+#include "jay/stack.h"
+
+#include <algorithm>
+#include <array>
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <stdexcept>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include <system_error>
+#include <unistd.h>
+
+namespace jay {
+namespace {
+constexpr uint32_t PCAP_MAGIC_USEC = 0xa1b2c3d4;
+constexpr uint32_t PCAP_MAGIC_NSEC = 0xa1b23c4d;
+constexpr size_t PCAP_HDR_SIZE = 24;
+constexpr size_t PCAP_REC_HDR_SIZE = 16;
+
+constexpr uint32_t PCAPNG_SHB = 0x0a0d0d0a;
+constexpr uint32_t PCAPNG_IDB = 1;
+constexpr uint32_t PCAPNG_SPB = 3;
+constexpr uint32_t PCAPNG_EPB = 6;
+constexpr uint32_t PCAPNG_BYTE_ORDER_MAGIC = 0x1a2b3c4d;
+/// the `if_tsresol` option of an interface description block
+constexpr uint16_t PCAPNG_OPT_TSRESOL = 9;
+
+constexpr uint32_t LINKTYPE_ETHERNET = 1;
+
+[[noreturn]] void throw_errno(const char *what) {
+  throw std::system_error(errno, std::system_category(), what);
+}
+
+/// Reads the fields of a capture stored in either byte order.
+struct FieldReader {
+  std::span<const uint8_t> data;
+  bool swapped = false;
+
+  uint16_t u16(size_t off) const {
+    uint16_t value;
+    std::memcpy(&value, data.data() + off, sizeof(value));
+    return swapped ? __builtin_bswap16(value) : value;
+  }
+  uint32_t u32(size_t off) const {
+    uint32_t value;
+    std::memcpy(&value, data.data() + off, sizeof(value));
+    return swapped ? __builtin_bswap32(value) : value;
+  }
+};
+
+/// Convert a timestamp in units of 10^-`exp` (or 2^-`exp` if the top bit of
+/// `exp` is set) seconds, as given by `if_tsresol`, to nanoseconds.
+uint64_t scale_ts(uint64_t ts, uint8_t exp) {
+  if (exp & 0x80)
+    return uint64_t((unsigned __int128)ts * 1000000000 >> (exp & 0x7f));
+  for (; exp < 9; exp++)
+    ts *= 10;
+  for (; exp > 9; exp--)
+    ts /= 10;
+  return ts;
+}
+} // namespace
+
+PcapInterface::PcapInterface(const std::string &input_path, Options opts)
+    : opts(opts) {
+  if (opts.speed < 0)
+    throw std::invalid_argument("speed must not be negative");
+
+  fd = open(input_path.c_str(), O_RDONLY | O_CLOEXEC);
+  if (fd == -1)
+    throw_errno("open capture");
+  try {
+    struct stat st;
+    if (fstat(fd, &st) == -1)
+      throw_errno("fstat capture");
+    file_size = size_t(st.st_size);
+    if (file_size < PCAP_HDR_SIZE)
+      throw std::invalid_argument("not a pcap or pcapng file");
+
+    map_file();
+    std::span<const uint8_t> data(mapping.begin(), mapping.size());
+    if (FieldReader{data}.u32(0) == PCAPNG_SHB)
+      index_pcapng(data);
+    else
+      index_pcap(data);
+
+    if (!opts.output_path.empty())
+      open_output(opts.output_path);
+  } catch (...) {
+    close(fd);
+    throw;
+  }
+}
+
+PcapInterface::~PcapInterface() {
+  if (output)
+    std::fclose(output);
+  close(fd);
+}
+
+void PcapInterface::map_file() {
+  // private, so that writes to the frames (which the stack doesn't do, as
+  // they are shared) could never reach the file
+  void *ptr = mmap(nullptr, file_size, PROT_READ | PROT_WRITE,
+                   MAP_PRIVATE | MAP_POPULATE, fd, 0);
+  if (ptr == MAP_FAILED)
+    throw_errno("capture mmap");
+  size_t size = file_size;
+  mapping = BufChunk(static_cast<uint8_t *>(ptr), size, 0,
+                     [size](uint8_t *ptr) { munmap(ptr, size); });
+}
+
+void PcapInterface::index_pcap(std::span<const uint8_t> data) {
+  FieldReader reader{data};
+  uint32_t magic = reader.u32(0);
+  if ((magic == __builtin_bswap32(PCAP_MAGIC_USEC)) ||
+      (magic == __builtin_bswap32(PCAP_MAGIC_NSEC))) {
+    reader.swapped = true;
+    magic = __builtin_bswap32(magic);
+  }
+  if ((magic != PCAP_MAGIC_USEC) && (magic != PCAP_MAGIC_NSEC))
+    throw std::invalid_argument("not a pcap or pcapng file");
+  if ((reader.u32(20) & 0xffff) != LINKTYPE_ETHERNET)
+    throw std::invalid_argument("capture link type is not Ethernet");
+  uint64_t frac_ns = magic == PCAP_MAGIC_NSEC ? 1 : 1000;
+
+  size_t off = PCAP_HDR_SIZE;
+  while (off + PCAP_REC_HDR_SIZE <= data.size()) {
+    uint32_t size = reader.u32(off + 8);
+    if (size > data.size() - off - PCAP_REC_HDR_SIZE)
+      break;
+    uint64_t ts = uint64_t(reader.u32(off)) * 1000000000 +
+                  uint64_t(reader.u32(off + 4)) * frac_ns;
+    frames.push_back({off + PCAP_REC_HDR_SIZE, size, ts});
+    off += PCAP_REC_HDR_SIZE + size;
+  }
+}
+
+void PcapInterface::index_pcapng(std::span<const uint8_t> data) {
+  /// the interfaces of the current section
+  struct PcapngIface {
+    bool ethernet;
+    uint8_t tsresol;
+  };
+  std::vector<PcapngIface> ifaces;
+  FieldReader reader{data};
+  uint64_t last_ts = 0;
+
+  size_t off = 0;
+  while (off + 12 <= data.size()) {
+    if (reader.u32(off) == PCAPNG_SHB) {
+      reader.swapped = false;
+      uint32_t bom = reader.u32(off + 8);
+      if (bom == __builtin_bswap32(PCAPNG_BYTE_ORDER_MAGIC))
+        reader.swapped = true;
+      else if (bom != PCAPNG_BYTE_ORDER_MAGIC)
+        throw std::invalid_argument("not a pcap or pcapng file");
+      ifaces.clear();
+    }
+    uint32_t type = reader.u32(off);
+    uint32_t len = reader.u32(off + 4);
+    if ((len < 12) || (len % 4) || (len > data.size() - off))
+      break;
+    // the body, excluding the trailing copy of the length
+    size_t body = off + 8, body_end = off + len - 4;
+
+    if ((type == PCAPNG_IDB) && (body + 8 <= body_end)) {
+      PcapngIface iface{reader.u16(body) == LINKTYPE_ETHERNET, 6};
+      for (size_t opt = body + 8; opt + 4 <= body_end;) {
+        uint16_t code = reader.u16(opt), opt_len = reader.u16(opt + 2);
+        if ((code == 0) || (opt + 4 + opt_len > body_end))
+          break;
+        if ((code == PCAPNG_OPT_TSRESOL) && (opt_len >= 1))
+          iface.tsresol = data[opt + 4];
+        opt += 4 + ((opt_len + 3) & ~3);
+      }
+      ifaces.push_back(iface);
+    } else if ((type == PCAPNG_EPB) && (body + 20 <= body_end)) {
+      uint32_t iface_id = reader.u32(body);
+      uint32_t size = reader.u32(body + 12);
+      if ((iface_id < ifaces.size()) && ifaces[iface_id].ethernet &&
+          (size <= body_end - body - 20)) {
+        uint64_t ts = (uint64_t(reader.u32(body + 4)) << 32) |
+                      reader.u32(body + 8);
+        last_ts = scale_ts(ts, ifaces[iface_id].tsresol);
+        frames.push_back({body + 20, size, last_ts});
+      }
+    } else if ((type == PCAPNG_SPB) && (body + 4 <= body_end)) {
+      // simple packets belong to the first interface and have no timestamp
+      size_t size = std::min<size_t>(reader.u32(body), body_end - body - 4);
+      if (!ifaces.empty() && ifaces[0].ethernet)
+        frames.push_back({body + 4, uint32_t(size), last_ts});
+    }
+    off += len;
+  }
+}
+
+void PcapInterface::open_output(const std::string &path) {
+  output = std::fopen(path.c_str(), "wb");
+  if (!output)
+    throw_errno("open pcap output");
+  struct {
+    uint32_t magic = PCAP_MAGIC_NSEC;
+    uint16_t version_major = 2;
+    uint16_t version_minor = 4;
+    int32_t thiszone = 0;
+    uint32_t sigfigs = 0;
+    uint32_t snaplen = 0x40000;
+    uint32_t linktype = LINKTYPE_ETHERNET;
+  } hdr;
+  std::fwrite(&hdr, sizeof(hdr), 1, output);
+}
+
+void PcapInterface::enqueue(PBuf packet) {
+  _stats.tx_packets++;
+  _stats.tx_bytes += packet->size();
+  if (!output)
+    return;
+
+  auto now = std::chrono::system_clock::now().time_since_epoch();
+  uint64_t ns =
+      std::chrono::duration_cast<std::chrono::nanoseconds>(now).count();
+  auto size = uint32_t(packet->size());
+  std::array<uint32_t, 4> rec_hdr{uint32_t(ns / 1000000000),
+                                  uint32_t(ns % 1000000000), size, size};
+  std::fwrite(rec_hdr.data(), sizeof(rec_hdr), 1, output);
+  std::array<iovec, MAX_SEGMENTS> iov;
+  size_t n_segs = packet->to_iovec(iov);
+  if (n_segs > iov.size()) {
+    packet->linearize();
+    n_segs = packet->to_iovec(iov);
+  }
+  for (size_t i = 0; i < n_segs; i++)
+    std::fwrite(iov[i].iov_base, 1, iov[i].iov_len, output);
+}
+
+void PcapInterface::flush() {
+  if (output)
+    std::fflush(output);
+}
+
+size_t PcapInterface::poll_rx_burst(Stack &stack, std::span<PBuf> packets) {
+  auto now = std::chrono::steady_clock::now();
+  if (!started) {
+    started = true;
+    start = pass_start = now;
+    _stats.passes = 1;
+  }
+
+  size_t n_packets = 0;
+  while (n_packets < packets.size()) {
+    if (next_frame == frames.size()) {
+      if (!opts.loop || frames.empty()) {
+        _done = true;
+        break;
+      }
+      // end the burst with the pass, so that the stack's drain loop ends
+      if (!pass_ended) {
+        pass_ended = true;
+        break;
+      }
+      pass_ended = false;
+      next_frame = 0;
+      pass_start = now;
+      _stats.passes++;
+    }
+    const Frame &frame = frames[next_frame];
+    if (opts.speed > 0) {
+      // signed, as the timestamps need not be ordered
+      auto recorded = int64_t(frame.ts - frames[0].ts);
+      std::chrono::nanoseconds offset(int64_t(double(recorded) / opts.speed));
+      if (pass_start + offset > now)
+        break;
+    }
+    packets[n_packets++] =
+        stack.pool.get(Buf(mapping.slice(frame.offset, frame.size)));
+    _stats.rx_packets++;
+    _stats.rx_bytes += frame.size;
+    next_frame++;
+  }
+  if (n_packets)
+    _stats.elapsed = now - start;
+  return n_packets;
+}
+} // namespace jay
@@ -18,6 +18,12 @@ void Socket::send_pbuf(PBuf packet, std::optional<IPAddr> dst_ip) {
   ip_stack.output(std::move(packet));
 }
 
+PBuf Socket::alloc_pbuf(const Buf &payload, bool may_copy) {
+  if (may_copy && (payload.size() <= copy_threshold))
+    return ip_stack.pool().copy(payload);
+  return ip_stack.pool().get(payload);
+}
+
 void Socket::listen(std::optional<IPAddr> local_addr, uint16_t local_port) {
   ip_stack.sock_table().listen(this, local_addr, local_port);
 }
@@ -1,4 +1,4 @@
-#include <iostream>
+#include <algorithm>
 #include <stdexcept>
 
 #include "jay/eth.h"
@@ -6,23 +6,54 @@
 
 namespace jay {
 void Stack::input(Interface *iface, PBuf packet) {
-  packet->iface = iface;
-  auto eth_header = packet->read_link_hdr<EthHeader>();
-  if (eth_header.has_error())
-    return;
-    
-  std::cout << "input:" << *packet;
-  switch (eth_header.value().ether_type()) {
-  case EtherType::ARP:
-    ip.arp_input(std::move(packet));
-    break;
-  case EtherType::IPV4:
-    ip.ip_input(std::move(packet), ip::IPVersion::V4);
-    break;
-  case EtherType::IPV6:
-    ip.ip_input(std::move(packet), ip::IPVersion::V6);
-    break;
+  input_burst(iface, std::span(&packet, 1));
+}
+
+void Stack::input_burst(Interface *iface, std::span<PBuf> packets) {
+  OutputBatch batch(*this);
+  size_t run_start = 0;
+  EtherType run_type{};
+  auto input_run = [&](size_t run_end) {
+    std::span<PBuf> run = packets.subspan(run_start, run_end - run_start);
+    if (run.empty())
+      return;
+    switch (run_type) {
+    case EtherType::ARP:
+      ip.arp_input(run);
+      break;
+    case EtherType::IPV4:
+      ip.ip_input(run, ip::IPVersion::V4);
+      break;
+    case EtherType::IPV6:
+      ip.ip_input(run, ip::IPVersion::V6);
+      break;
+    }
+  };
+
+  for (size_t i = 0; i < packets.size(); i++) {
+    PBuf &packet = packets[i];
+    packet->iface = iface;
+    if (!iface->rx_csum_offload())
+      packet->rx_csum_valid = false;
+    auto eth_header = packet->read_link_hdr<EthHeader>();
+    if (eth_header.has_error()) {
+      input_run(i);
+      packet.reset();
+      run_start = i + 1;
+      continue;
+    }
+    EtherType ether_type = eth_header.value().ether_type();
+    if ((i == run_start) || (ether_type != run_type)) {
+      input_run(i);
+      run_start = i;
+      run_type = ether_type;
+    }
   }
+  input_run(packets.size());
+
+  // packets of unknown EtherTypes
+  for (PBuf &packet : packets)
+    packet.reset();
 }
 
 void Stack::output(PBuf packet) {
@@ -31,19 +62,75 @@ void Stack::output(PBuf packet) {
         "output of packet with no assigned output interface");
   packet->eth().src_haddr() = packet->iface->addr();
   packet->unmask(packet->eth().size());
-  packet->iface->enqueue(std::move(packet));
+  Interface *iface = packet->iface;
+  if (!iface->scatter_gather()) {
+    packet->linearize();
+  } else if (packet->segment_count() > iface->max_segments()) {
+    if (compact_policy.before_output)
+      packet->compact(compact_policy.threshold);
+    if (packet->segment_count() > iface->max_segments())
+      packet->linearize();
+  }
+  if (batch_depth > 0)
+    tx_pending.push_back(std::move(packet));
+  else
+    iface->enqueue(std::move(packet));
+}
+
+void Stack::flush_output() {
+  // the batch is taken out of tx_pending before being handed over, as the
+  // interfaces may feed packets back to the stack meanwhile: with no batch
+  // open, their output isn't staged, except by a nested input_burst, which
+  // stages it in the swapped-in spare and flushes it itself
+  std::vector<PBuf> batch = std::move(tx_spare);
+  batch.swap(tx_pending);
+  size_t run_start = 0;
+  while (run_start < batch.size()) {
+    Interface *iface = batch[run_start]->iface;
+    size_t run_end = run_start + 1;
+    while ((run_end < batch.size()) && (batch[run_end]->iface == iface))
+      run_end++;
+    iface->enqueue_burst(
+        std::span(batch).subspan(run_start, run_end - run_start));
+    run_start = run_end;
+  }
+  batch.clear();
+  tx_spare = std::move(batch);
 }
 
 void Stack::poll() {
-  ip.poll();
+  {
+    OutputBatch batch(*this);
+    ip.poll();
+  }
+  // each burst flushes its output as it ends (see input_burst), so that the
+  // interfaces transmit the replies (and poll_tx completes them) within the
+  // same poll, and the staged output stays bounded by a burst
   for (auto &iface : ifaces) {
-    iface->poll_rx(*this);
+    size_t n_packets;
+    do {
+      n_packets = iface->poll_rx_burst(*this, rx_burst);
+      input_burst(iface.get(), std::span(rx_burst).first(n_packets));
+    } while (n_packets == rx_burst.size());
     iface->poll_tx(*this);
   }
 }
 
 void Stack::add_interface(std::shared_ptr<Interface> iface) {
   ifaces.push_back(iface);
+  update_room();
   ip.setup_interface(iface.get());
 }
+
+void Stack::set_room(PBufRoom room) {
+  base_room = room;
+  update_room();
+}
+
+void Stack::update_room() {
+  PBufRoom room = base_room;
+  for (auto &iface : ifaces)
+    room.headroom = std::max(room.headroom, base_room.headroom + iface->headroom());
+  pool.set_room(room);
+}
 }; // namespace jay
@@ -15,6 +15,7 @@
 #include <linux/if_arp.h>
 
 #include <sys/ioctl.h>
+#include <sys/uio.h>
 
 
 #include "jay/if.h"
@@ -23,7 +24,7 @@
 
 class TAPInterface : public jay::Interface {
 public:
-  TAPInterface(std::string if_name, jay::HWAddr hwaddr, size_t mtu = 1500) : recv_packet(mtu + jay::EthHeader::SIZE), if_name(if_name), _hwaddr(hwaddr) {
+  TAPInterface(std::string if_name, jay::HWAddr hwaddr, size_t mtu = 1500) : if_name(if_name), _hwaddr(hwaddr) {
     fd = open("/dev/net/tun", O_RDWR);
     if (fd == -1) {
       perror("tun open");
@@ -49,29 +50,30 @@ public:
   
   void enqueue(jay::PBuf packet) override {
     //std::cout << "enqueue:" << *packet;
-    jay::Buf contig_buf = packet->as_contiguous();
-    if (write(fd, contig_buf.begin().contiguous().data(), contig_buf.size()) == -1) {
-      perror("write");
+    std::array<iovec, MAX_SEGMENTS> iov;
+    size_t n_segs = packet->to_iovec(iov);
+    if (writev(fd, iov.data(), n_segs) == -1) {
+      perror("writev");
       return;
     }
   }
 
-  void poll_rx(jay::Stack& stack) override {
-    while (true) {
-    int read_len;
-    if ((read_len = read(fd, recv_packet->begin().contiguous().data(), recv_packet->size())) == -1) {
-      if (errno == EAGAIN) {
-        return;
+  size_t poll_rx_burst(jay::Stack &stack,
+                       std::span<jay::PBuf> packets) override {
+    size_t n_packets = 0;
+    for (; n_packets < packets.size(); n_packets++) {
+      jay::PBuf recv_packet = stack.pool.get(_mtu + jay::EthHeader::SIZE);
+      int read_len;
+      if ((read_len = read(fd, recv_packet->begin().contiguous().data(), recv_packet->size())) == -1) {
+        if (errno != EAGAIN)
+          perror("read");
+        break;
       }
-      perror("read");
-      return;
-    }
-    std::cout << std::format("read {} bytes from interface\n", read_len);
-    recv_packet->truncate(read_len);
-//    std::cout << "poll_rx:" << *recv_packet;
-    stack.input(this, std::move(recv_packet)); 
-    recv_packet = jay::PBuf(_mtu + jay::EthHeader::SIZE);
+      std::cout << std::format("read {} bytes from interface\n", read_len);
+      recv_packet->truncate(read_len);
+      packets[n_packets] = std::move(recv_packet);
     }
+    return n_packets;
   }
 
   void poll_tx(jay::Stack&) override {
@@ -85,6 +87,14 @@ public:
     return _mtu;
   }
 
+  bool scatter_gather() const noexcept override {
+    return true;
+  }
+
+  size_t max_segments() const noexcept override {
+    return MAX_SEGMENTS;
+  }
+
   void set_mtu(uint16_t mtu) {
     int sock = socket(PF_INET, SOCK_STREAM, 0);
     struct ifreq ifr;
@@ -100,7 +110,8 @@ public:
   }
 
 private:
-  jay::PBuf recv_packet;
+  static constexpr size_t MAX_SEGMENTS = 16;
+
   std::string if_name;
   int fd;
   jay::HWAddr _hwaddr;
@@ -0,0 +1,88 @@
+#include "jay/virtual_switch.h"
+
+#include <cstring>
+
+namespace jay {
+std::shared_ptr<MemoryPort> VirtualSwitch::add_port(HWAddr hwaddr) {
+  Port port;
+  port.ingress = std::make_shared<MemoryPort::Ring>(opts.ring_size);
+  port.egress = std::make_shared<MemoryPort::Ring>(opts.ring_size);
+  port.iface = std::make_shared<MemoryPort>(hwaddr, opts.mtu, port.egress,
+                                            port.ingress, opts.csum_offload);
+  ports.push_back(port);
+  return port.iface;
+}
+
+void VirtualSwitch::poll() {
+  while (burst.size() < BURST)
+    burst.emplace_back(nullptr);
+  for (size_t in_port = 0; in_port < ports.size(); in_port++) {
+    size_t n_packets;
+    do {
+      n_packets = ports[in_port].ingress->pop_burst(burst);
+      for (PBuf &packet : std::span(burst).first(n_packets))
+        forward(in_port, std::move(packet));
+    } while (n_packets == burst.size());
+  }
+}
+
+std::optional<size_t> VirtualSwitch::port_of(HWAddr hwaddr) const {
+  auto station_it = stations.find(hwaddr);
+  if (station_it == stations.end())
+    return std::nullopt;
+  return station_it->second;
+}
+
+void VirtualSwitch::forward(size_t in_port, PBuf packet) {
+  // the addresses are read in place, as parsing the header would mask it
+  std::span<uint8_t> frame = packet->begin().contiguous();
+  if (frame.size() < EthHeader::SIZE) {
+    _stats.dropped++;
+    return;
+  }
+  HWAddr dst_haddr, src_haddr;
+  std::memcpy(dst_haddr.data(), frame.data(), dst_haddr.size());
+  std::memcpy(src_haddr.data(), frame.data() + 6, src_haddr.size());
+
+  bool is_multicast = dst_haddr[0] & 1;
+  if (!(src_haddr[0] & 1))
+    stations[src_haddr] = in_port;
+
+  std::optional<size_t> out_port;
+  if (!is_multicast)
+    out_port = port_of(dst_haddr);
+  if (out_port.has_value()) {
+    if (*out_port == in_port) {
+      _stats.dropped++;
+      return;
+    }
+    _stats.forwarded++;
+    transmit(*out_port, std::move(packet));
+    return;
+  }
+
+  // the receiving stacks may rewrite the frames in place (e.g. when replying),
+  // so each port gets a copy of its own, except for the last one
+  _stats.flooded++;
+  std::optional<size_t> last_port;
+  for (size_t port = 0; port < ports.size(); port++) {
+    if (port == in_port)
+      continue;
+    if (last_port.has_value()) {
+      PBuf copy;
+      Buf data(packet->size(), packet->get_allocator());
+      packet->copy_csum(data.begin().contiguous().data());
+      copy->buf() = std::move(data);
+      transmit(*last_port, std::move(copy));
+    }
+    last_port = port;
+  }
+  if (last_port.has_value())
+    transmit(*last_port, std::move(packet));
+}
+
+void VirtualSwitch::transmit(size_t out_port, PBuf packet) {
+  if (!ports[out_port].egress->push(std::move(packet)))
+    _stats.dropped++;
+}
+} // namespace jay
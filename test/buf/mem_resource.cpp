@@ -0,0 +1,40 @@
+#include <catch2/catch_test_macros.hpp>
+
+#include "jay/buf/mem_resource.h"
+#include "jay/buf/sbuf.h"
+
+TEST_CASE("PacketMemoryResource serves size classes", "[buf]") {
+  jay::PacketMemoryResource mem;
+
+  void *small = mem.allocate(100);
+  void *mtu = mem.allocate(1600);
+  REQUIRE(mem.stats().regions == 2);
+  REQUIRE(mem.stats().in_use[0] == 1);
+  REQUIRE(mem.stats().in_use[1] == 1);
+  REQUIRE(reinterpret_cast<uintptr_t>(small) %
+              jay::PacketMemoryResource::SLOT_ALIGN ==
+          0);
+
+  mem.deallocate(small, 100);
+  REQUIRE(mem.allocate(120) == small);
+  REQUIRE(mem.stats().regions == 2);
+
+  void *mtu2 = mem.allocate(2000);
+  REQUIRE(static_cast<uint8_t *>(mtu2) - static_cast<uint8_t *>(mtu) ==
+          jay::PacketMemoryResource::slot_size(2000));
+
+  void *large = mem.allocate(20000);
+  REQUIRE(mem.stats().upstream_allocs == 1);
+  mem.deallocate(large, 20000);
+
+  SECTION("buffers allocate from the resource") {
+    jay::Buf buf(1500, &mem);
+    REQUIRE(mem.stats().in_use[1] == 3);
+    buf.mask(10);
+    buf.reserve_before(64);
+    REQUIRE(mem.stats().in_use[0] == 2);
+    REQUIRE(buf.get_allocator().resource() == &mem);
+  }
+  REQUIRE(mem.stats().in_use[0] == 1);
+  REQUIRE(mem.stats().in_use[1] == 2);
+}
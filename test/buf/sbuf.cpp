@@ -1,6 +1,8 @@
 #include "jay/buf/sbuf.h"
 #include <catch2/catch_test_macros.hpp>
 #include <catch2/matchers/catch_matchers_range_equals.hpp>
+#include <numeric>
+#include <random>
 
 TEST_CASE("sbuf", "[sbuf]") {
   jay::Buf buf(10);
@@ -31,3 +33,141 @@ TEST_CASE("sbuf", "[sbuf]") {
   std::fill(buf.begin(), buf.end(), 'X');
   REQUIRE_THAT(buf, Catch::Matchers::RangeEquals({'X', 'X', 'X', 'X', 'X'}));
 }
+
+TEST_CASE("BufChunk reference counting", "[sbuf]") {
+  size_t deleted = 0;
+  uint8_t user_data[16] = {1, 2, 3, 4, 5, 6, 7, 8};
+  {
+    jay::BufChunk chunk(user_data, 8, 2,
+                        [&](uint8_t *ptr) {
+                          REQUIRE(ptr == user_data);
+                          deleted++;
+                        });
+    REQUIRE(chunk.is_unique());
+    REQUIRE(*chunk.begin() == 3);
+    REQUIRE(chunk.end() - chunk.begin() == 8);
+
+    jay::BufChunk sliced = chunk.slice(2, 4);
+    REQUIRE(!chunk.is_unique());
+    REQUIRE(*sliced.begin() == 5);
+    REQUIRE(sliced.end() == sliced.begin() + 4);
+
+    jay::Buf buf(std::move(sliced));
+    chunk = jay::BufChunk(4);
+    REQUIRE(deleted == 0);
+  }
+  REQUIRE(deleted == 1);
+}
+
+TEST_CASE("Buf reassembles long chunk chains", "[sbuf]") {
+  const size_t frag_size = 1480;
+  const size_t n_frags = 45;
+  std::vector<uint8_t> expected(frag_size * n_frags);
+  for (size_t i = 0; i < expected.size(); i++)
+    expected[i] = (i * 7) % 251;
+
+  std::vector<size_t> order(n_frags);
+  std::iota(order.begin(), order.end(), 0);
+  std::shuffle(order.begin(), order.end(), std::mt19937(1234));
+
+  jay::Buf reass(20);
+  reass.mask(20);
+  for (size_t frag_idx : order) {
+    jay::Buf frag(frag_size + 8);
+    frag.mask(8);
+    std::copy_n(expected.begin() + frag_idx * frag_size, frag_size,
+                frag.begin());
+    REQUIRE(reass.insert(frag, frag_idx * frag_size).has_value());
+  }
+  REQUIRE(reass.is_complete());
+  REQUIRE(reass.size() == expected.size());
+  REQUIRE_THAT(reass, Catch::Matchers::RangeEquals(expected));
+
+  for (size_t offset : {size_t(0), size_t(1), frag_size - 1, frag_size,
+                        expected.size() / 2, expected.size() - 1}) {
+    REQUIRE(*reass.seek(offset) == expected[offset]);
+    REQUIRE(reass.seek(offset) == reass.begin() + offset);
+  }
+  REQUIRE(reass.seek(expected.size()) == reass.end());
+
+  reass.truncate(frag_size * 10 + 5);
+  REQUIRE_THAT(reass, Catch::Matchers::RangeEquals(std::span(
+                          expected.begin(), frag_size * 10 + 5)));
+}
+
+TEST_CASE("Buf compacts small chunks", "[sbuf]") {
+  jay::Buf buf(8);
+  std::fill(buf.begin(), buf.end(), 'H');
+  buf.mask(4);
+  uint8_t val = 'a';
+  for (size_t size : {3, 5, 100, 2, 2, 2, 7}) {
+    jay::Buf chunk(size);
+    std::fill(chunk.begin(), chunk.end(), val++);
+    buf.insert(chunk, buf.size());
+  }
+  std::vector<uint8_t> expected(buf.begin(), buf.end());
+  REQUIRE(buf.chunk_count() == 8);
+
+  REQUIRE(buf.compact(10) == 4);
+  REQUIRE(buf.chunk_count() == 4);
+  REQUIRE_THAT(buf, Catch::Matchers::RangeEquals(expected));
+  buf.unmask(4);
+  REQUIRE(std::ranges::all_of(buf.begin(), buf.begin() + 8,
+                              [](uint8_t b) { return b == 'H'; }));
+}
+
+TEST_CASE("Buf moves its chunks without copying", "[sbuf]") {
+  jay::Buf buf(10);
+  std::fill(buf.begin(), buf.end(), 'A');
+  buf.mask(4);
+  const uint8_t *data = &*buf.begin();
+
+  jay::Buf moved(std::move(buf));
+  REQUIRE(&*moved.begin() == data);
+  REQUIRE(moved.size() == 6);
+  REQUIRE(buf.size() == 0);
+  REQUIRE(buf.begin() == buf.end());
+
+  buf = std::move(moved);
+  REQUIRE(&*buf.begin() == data);
+  REQUIRE(moved.size() == 0);
+}
+
+TEST_CASE("Buf describes its chunks by iovecs", "[sbuf]") {
+  jay::Buf buf(10);
+  buf.mask(4);
+  buf.reserve_before(8);
+  buf.unmask(8);
+  jay::Buf payload(20);
+  buf.insert(payload, buf.size());
+  REQUIRE(buf.segment_count() == 3);
+
+  std::array<iovec, 4> iov;
+  REQUIRE(buf.to_iovec(iov) == 3);
+  REQUIRE(iov[0].iov_len == 8);
+  REQUIRE(iov[1].iov_len == 6);
+  REQUIRE(iov[2].iov_len == 20);
+  REQUIRE(iov[2].iov_base == &*payload.begin());
+
+  std::array<iovec, 1> short_iov;
+  REQUIRE(buf.to_iovec(short_iov) == 3);
+  REQUIRE(short_iov[0].iov_len == 8);
+}
+
+TEST_CASE("Buf copies shared bytes before the masked position", "[sbuf]") {
+  jay::Buf buf(10);
+  std::iota(buf.begin(), buf.end(), 0);
+  buf.mask(6);
+  jay::Buf shared(buf);
+  const uint8_t *payload = &*buf.begin();
+
+  buf.unshare_before(4);
+  REQUIRE(buf.has_room_before(4));
+  REQUIRE(&*buf.begin() == payload);
+  buf.unmask(4);
+  *buf.begin() = 0xff;
+  shared.unmask(4);
+  REQUIRE(*shared.begin() == 2);
+  REQUIRE_THAT(buf, Catch::Matchers::RangeEquals(
+                        std::vector<uint8_t>{0xff, 3, 4, 5, 6, 7, 8, 9}));
+}
@@ -0,0 +1,74 @@
+#pragma once
+
+#include <cstring>
+#include <memory>
+#include <vector>
+
+#include "jay/stack.h"
+
+/// Addresses, frame builders and stack set-up shared by the tests feeding
+/// frames to a [jay::Stack].
+namespace jay::test {
+inline const HWAddr LOCAL_HADDR{0x02, 0, 0, 0, 0, 0x01};
+inline const HWAddr REMOTE_HADDR{0x02, 0, 0, 0, 0, 0x02};
+inline const ip::IPv4Addr LOCAL_IADDR{10, 0, 0, 1};
+inline const ip::IPv4Addr REMOTE_IADDR{10, 0, 0, 2};
+
+/// Add `iface` to `stack`, assigning it `iaddr` and routing its /24 network
+/// through it.
+inline void attach(Stack &stack, std::shared_ptr<Interface> iface,
+                   ip::IPv4Addr iaddr = LOCAL_IADDR) {
+  stack.add_interface(iface);
+  stack.ip.assign_ip(iface.get(), iaddr, 24);
+  stack.ip.router().add_route(iaddr, 24, iface.get(), std::nullopt, iaddr);
+}
+
+/// Return an Ethernet frame from the remote to the local station with
+/// `payload_size` zero bytes of payload.
+inline std::vector<uint8_t> eth_frame(EtherType ether_type,
+                                      size_t payload_size) {
+  std::vector<uint8_t> data(EthHeader::SIZE + payload_size);
+  std::memcpy(&data[0], LOCAL_HADDR.data(), 6);
+  std::memcpy(&data[6], REMOTE_HADDR.data(), 6);
+  data[12] = uint16_t(ether_type) >> 8;
+  data[13] = uint16_t(ether_type) & 0xff;
+  return data;
+}
+
+/// Return an ICMP echo request from the remote to the local station.
+inline std::vector<uint8_t> echo_request(uint16_t seq) {
+  std::vector<uint8_t> data = eth_frame(EtherType::IPV4, 20 + 8);
+  uint8_t *ip_hdr = &data[EthHeader::SIZE];
+  ip_hdr[0] = 0x45;
+  ip_hdr[3] = 20 + 8;
+  ip_hdr[8] = 64;
+  ip_hdr[9] = uint8_t(ip::IPProto::ICMP);
+  std::memcpy(ip_hdr + 12, REMOTE_IADDR.data(), 4);
+  std::memcpy(ip_hdr + 16, LOCAL_IADDR.data(), 4);
+  uint16_t csum = ip::inet_csum(std::span<const uint8_t>(ip_hdr, 20));
+  std::memcpy(ip_hdr + 10, &csum, 2);
+
+  uint8_t *icmp_hdr = ip_hdr + 20;
+  icmp_hdr[0] = 8;
+  icmp_hdr[7] = seq;
+  csum = ip::inet_csum(std::span<const uint8_t>(icmp_hdr, 8));
+  std::memcpy(icmp_hdr + 2, &csum, 2);
+  return data;
+}
+
+/// Return an ARP reply announcing the remote station to the local one.
+inline std::vector<uint8_t> arp_reply() {
+  std::vector<uint8_t> data = eth_frame(EtherType::ARP, 28);
+  uint8_t *arp = &data[EthHeader::SIZE];
+  arp[1] = 1;
+  arp[2] = 0x08;
+  arp[4] = 6;
+  arp[5] = 4;
+  arp[7] = 2;
+  std::memcpy(arp + 8, REMOTE_HADDR.data(), 6);
+  std::memcpy(arp + 14, REMOTE_IADDR.data(), 4);
+  std::memcpy(arp + 18, LOCAL_HADDR.data(), 6);
+  std::memcpy(arp + 24, LOCAL_IADDR.data(), 4);
+  return data;
+}
+} // namespace jay::test
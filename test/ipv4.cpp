@@ -39,3 +39,34 @@ TEST_CASE("IPv4 header (de)serialization", "[ipv4]") {
   REQUIRE(jay::ip::IPv4Addr(hdr.src_addr()) == jay::ip::IPv4Addr {192, 168, 1, 10});
   REQUIRE(jay::ip::IPv4Addr(hdr.dst_addr()) == jay::ip::IPv4Addr {192, 168, 1, 1});
 }
+
+TEST_CASE("IPv4 header checksum is patched incrementally", "[ipv4]") {
+  std::vector<uint8_t> buf(jay::ip::IPv4Header::MIN_SIZE);
+  jay::StructWriter cur{buf};
+  jay::ip::IPv4Header hdr = jay::ip::IPv4Header::construct(cur, jay::ip::IPProto::UDP).value();
+  hdr.ttl() = 1;
+  hdr.src_addr() = jay::ip::IPv4Addr {10, 0, 0, 1};
+  hdr.dst_addr() = jay::ip::IPv4Addr {10, 0, 0, 255};
+  hdr.total_len() = 0xfffe;
+  hdr.hdr_csum() = jay::ip::inet_csum(hdr.cursor().span());
+
+  hdr.update_field(hdr.ttl(), uint8_t(0), hdr.hdr_csum());
+  hdr.update_field(hdr.total_len(), uint16_t(1500), hdr.hdr_csum());
+  hdr.update_field(hdr.dst_addr(), jay::ip::IPv4Addr {192, 168, 100, 7}, hdr.hdr_csum());
+  REQUIRE(hdr.ttl() == 0);
+  REQUIRE(hdr.total_len() == 1500);
+  REQUIRE(jay::ip::inet_csum(hdr.cursor().span()) == 0);
+  REQUIRE(jay::ip::IPv4Header::read(cur).has_value());
+}
+
+TEST_CASE("IPv4 header checksum verification can be skipped", "[ipv4]") {
+  std::vector<uint8_t> buf(jay::ip::IPv4Header::MIN_SIZE);
+  jay::StructWriter cur{buf};
+  jay::ip::IPv4Header hdr = jay::ip::IPv4Header::construct(cur, jay::ip::IPProto::UDP).value();
+  hdr.total_len() = jay::ip::IPv4Header::MIN_SIZE;
+  hdr.hdr_csum() = uint16_t(jay::ip::inet_csum(hdr.cursor().span()) + 1);
+
+  REQUIRE(jay::ip::IPv4Header::read(cur).error() == jay::ip::IPHeaderError::CHECKSUM_ERROR);
+  REQUIRE(jay::ip::IPv4Header::read(cur, false).has_value());
+  REQUIRE(hdr.field_offset(hdr.hdr_csum()) == 10);
+}
@@ -0,0 +1,86 @@
+#include <catch2/catch_test_macros.hpp>
+
+#include "jay/ip/common.h"
+#include "jay/mem_accounting.h"
+#include "jay/neigh.h"
+#include "jay/pbuf.h"
+
+TEST_CASE("MemAccounting enforces budgets and sheds under pressure",
+          "[mem]") {
+  using enum jay::MemSubsystem;
+  using enum jay::MemPriority;
+  jay::MemAccounting accounting;
+  accounting.set_watermarks(1000, 2000);
+  accounting.set_budget(REASSEMBLY, {.max_bytes = 1500, .max_entries = 2});
+
+  REQUIRE(accounting.charge(REASSEMBLY, 600, SPECULATIVE));
+  REQUIRE(accounting.pressure() == jay::MemPressure::NONE);
+  REQUIRE(accounting.charge(REASSEMBLY, 600, SPECULATIVE));
+  REQUIRE(!accounting.charge(REASSEMBLY, 100, ESTABLISHED));
+  REQUIRE(accounting.stats(REASSEMBLY).over_budget == 1);
+
+  REQUIRE(accounting.pressure() == jay::MemPressure::LOW);
+  REQUIRE(!accounting.charge(SOCKET, 100, SPECULATIVE));
+  REQUIRE(accounting.charge(SOCKET, 900, NEW_FLOW));
+  REQUIRE(accounting.stats(SOCKET).shed == 1);
+
+  REQUIRE(accounting.pressure() == jay::MemPressure::HIGH);
+  REQUIRE(!accounting.charge(SOCKET, 100, NEW_FLOW));
+  REQUIRE(accounting.charge(SOCKET, 100, ESTABLISHED));
+  REQUIRE(accounting.total_bytes() == 2200);
+
+  accounting.release(SOCKET, 1000, 2);
+  accounting.release(REASSEMBLY, 1200, 2);
+  REQUIRE(accounting.pressure() == jay::MemPressure::NONE);
+  REQUIRE(accounting.stats(REASSEMBLY).entries == 0);
+  REQUIRE(accounting.stats(REASSEMBLY).peak_bytes == 1200);
+  REQUIRE(accounting.stats(SOCKET).admitted == 2);
+}
+
+TEST_CASE("NeighCache bounds the queues of unresolved neighbours", "[mem]") {
+  jay::MemAccounting accounting;
+  jay::NeighCache ncache;
+  ncache.max_queue_len = 2;
+  ncache.set_accounting(&accounting);
+  ncache.set_callbacks([](auto, auto, auto, auto) {},
+                       [](jay::ip::IPAddr, jay::Neighbour &) {});
+
+  jay::ip::IPAddr nh_iaddr = jay::ip::IPv4Addr{0x1, 0x2, 0x3, 0x4};
+  size_t packet_bytes = 0;
+  for (size_t i = 0; i < 3; i++) {
+    jay::PBuf packet;
+    packet->reserve_headers();
+    packet->construct_net_hdr<jay::ip::IPHeader>(jay::ip::IPVersion::V4,
+                                                 jay::ip::IPProto::UDP);
+    packet->nh_iaddr = nh_iaddr;
+    packet_bytes = packet->total_size();
+    REQUIRE(!ncache.resolve(std::move(packet)).has_value());
+  }
+
+  const auto &queue_stats = accounting.stats(jay::MemSubsystem::NEIGH_QUEUE);
+  REQUIRE(ncache.at(nh_iaddr)->queue.size() == 2);
+  REQUIRE(queue_stats.entries == 2);
+  REQUIRE(queue_stats.bytes == 2 * packet_bytes);
+
+  SECTION("under pressure") {
+    accounting.set_watermarks(0, 1 << 20);
+    jay::PBuf packet;
+    packet->reserve_headers();
+    packet->construct_net_hdr<jay::ip::IPHeader>(jay::ip::IPVersion::V4,
+                                                 jay::ip::IPProto::UDP);
+    packet->nh_iaddr = nh_iaddr;
+    REQUIRE(!ncache.resolve(std::move(packet)).has_value());
+    REQUIRE(ncache.at(nh_iaddr)->queue.size() == 2);
+    REQUIRE(queue_stats.shed == 1);
+  }
+
+  SECTION("resolution") {
+    jay::HWAddr nh_haddr{0x11, 0x22, 0x33, 0x44, 0x55, 0x66};
+    auto queued =
+        ncache.process_adv(nh_iaddr, nh_haddr, {.solicited = true});
+    REQUIRE(queued.has_value());
+    REQUIRE(queued.value().size() == 2);
+    REQUIRE(queue_stats.entries == 0);
+    REQUIRE(queue_stats.bytes == 0);
+  }
+}
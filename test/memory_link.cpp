@@ -0,0 +1,165 @@
+#include <catch2/catch_test_macros.hpp>
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "helpers.h"
+#include "jay/memory_link.h"
+#include "jay/stack.h"
+#include "jay/virtual_switch.h"
+
+namespace {
+jay::HWAddr station_haddr(uint8_t idx) { return {0x02, 0, 0, 0, 0, idx}; }
+jay::ip::IPv4Addr station_iaddr(uint8_t idx) { return {10, 0, 0, idx}; }
+
+/// A stack attached to a memory port, echoing the UDP datagrams it receives
+/// on port 7 and recording the ones received on port 1000.
+struct Station {
+  jay::Stack stack;
+  jay::udp::UDPSocket echo_sock = stack.ip.udp_sock();
+  jay::udp::UDPSocket client_sock = stack.ip.udp_sock();
+  std::vector<std::string> replies;
+
+  Station(std::shared_ptr<jay::MemoryPort> port, uint8_t idx)
+      : Station(port, station_iaddr(idx)) {}
+  Station(std::shared_ptr<jay::MemoryPort> port, jay::ip::IPv4Addr iaddr) {
+    jay::test::attach(stack, port, iaddr);
+    echo_sock.listen(std::nullopt, 7);
+    echo_sock.on_data_fn = [](jay::udp::UDPSocket &sock, const jay::Buf &buf,
+                              jay::ip::IPAddr addr, uint16_t port) {
+      sock.send(buf, addr, port);
+    };
+    client_sock.listen(std::nullopt, 1000);
+    client_sock.on_data_fn = [this](jay::udp::UDPSocket &, const jay::Buf &buf,
+                                    jay::ip::IPAddr, uint16_t) {
+      std::string reply;
+      for (uint8_t byte : buf)
+        reply.push_back(char(byte));
+      replies.push_back(reply);
+    };
+  }
+
+  void send(const std::string &data, uint8_t dst_idx) {
+    send(data, station_iaddr(dst_idx));
+  }
+  void send(const std::string &data, jay::ip::IPv4Addr dst_iaddr) {
+    jay::Buf buf(data.size());
+    std::copy(data.begin(), data.end(), buf.begin());
+    client_sock.send(buf, dst_iaddr, 7);
+  }
+};
+} // namespace
+
+TEST_CASE("Memory link connects two stacks", "[memory_link]") {
+  jay::MemoryLink::Options opts;
+  SECTION("with checksum offload") { opts.csum_offload = true; }
+  SECTION("without checksum offload") { opts.csum_offload = false; }
+  jay::MemoryLink link(station_haddr(1), station_haddr(2), opts);
+  Station a(link.a(), 1), b(link.b(), 2);
+
+  a.send("hello", 2);
+  a.send(std::string(4000, 'x'), 2);
+  for (int i = 0; i < 8; i++) {
+    a.stack.poll();
+    b.stack.poll();
+  }
+
+  REQUIRE(a.replies == std::vector<std::string>{"hello", std::string(4000, 'x')});
+  REQUIRE(link.a()->stats().tx_packets == link.b()->stats().rx_packets);
+  REQUIRE(link.b()->stats().tx_packets == link.a()->stats().rx_packets);
+  REQUIRE(link.a()->stats().tx_drops == 0);
+}
+
+TEST_CASE("Partial checksums are completed when forwarded without offload",
+          "[memory_link]") {
+  // a's link leaves the checksums partial, b's link carries them complete;
+  // the router in between also fragments the datagrams for b's smaller MTU
+  const jay::ip::IPv4Addr a_iaddr{10, 0, 0, 1}, a_gateway{10, 0, 0, 254};
+  const jay::ip::IPv4Addr b_iaddr{10, 0, 1, 2}, b_gateway{10, 0, 1, 254};
+  jay::MemoryLink a_link(station_haddr(1), station_haddr(3),
+                         {.mtu = 9000, .csum_offload = true});
+  jay::MemoryLink b_link(station_haddr(2), station_haddr(4),
+                         {.csum_offload = false});
+  Station a(a_link.a(), a_iaddr), b(b_link.a(), b_iaddr);
+  jay::Stack router;
+  jay::test::attach(router, a_link.b(), a_gateway);
+  jay::test::attach(router, b_link.b(), b_gateway);
+  a.stack.ip.router().add_route(jay::ip::IPv4Addr{10, 0, 1, 0}, 24,
+                                a_link.a().get(), a_gateway, a_iaddr);
+  b.stack.ip.router().add_route(jay::ip::IPv4Addr{10, 0, 0, 0}, 24,
+                                b_link.a().get(), b_gateway, b_iaddr);
+
+  a.send("hello", b_iaddr);
+  a.send(std::string(4000, 'x'), b_iaddr);
+  for (int i = 0; i < 16; i++) {
+    a.stack.poll();
+    router.poll();
+    b.stack.poll();
+  }
+
+  REQUIRE(a.replies == std::vector<std::string>{"hello", std::string(4000, 'x')});
+}
+
+TEST_CASE("Zero-copy sends reference the payload until it is consumed",
+          "[memory_link]") {
+  jay::MemoryLink link(station_haddr(1), station_haddr(2));
+  Station a(link.a(), 1), b(link.b(), 2);
+  const std::string data = "small";
+  bool released = false;
+
+  a.client_sock.send(
+      std::span(reinterpret_cast<const uint8_t *>(data.data()), data.size()),
+      [&](std::span<const uint8_t>) { released = true; }, station_iaddr(2), 7);
+  REQUIRE(!released);
+  for (int i = 0; i < 8; i++) {
+    a.stack.poll();
+    b.stack.poll();
+  }
+
+  REQUIRE(a.replies == std::vector<std::string>{data});
+  REQUIRE(released);
+}
+
+TEST_CASE("Memory link drops frames when the ring is full", "[memory_link]") {
+  jay::MemoryLink link(station_haddr(1), station_haddr(2), {.ring_size = 2});
+  for (int i = 0; i < 3; i++)
+    link.a()->enqueue(jay::PBuf());
+  REQUIRE(link.a()->stats().tx_packets == 2);
+  REQUIRE(link.a()->stats().tx_drops == 1);
+}
+
+TEST_CASE("Virtual switch learns the stations", "[memory_link]") {
+  jay::VirtualSwitch vswitch;
+  std::vector<std::unique_ptr<Station>> stations;
+  for (uint8_t idx = 1; idx <= 3; idx++)
+    stations.push_back(std::make_unique<Station>(
+        vswitch.add_port(station_haddr(idx)), idx));
+  auto poll = [&] {
+    for (int i = 0; i < 8; i++) {
+      for (auto &station : stations)
+        station->stack.poll();
+      vswitch.poll();
+    }
+  };
+
+  stations[0]->send("to 2", 2);
+  stations[0]->send("to 3", 3);
+  poll();
+  REQUIRE(stations[0]->replies == std::vector<std::string>{"to 2", "to 3"});
+  for (uint8_t idx = 1; idx <= 3; idx++)
+    REQUIRE(vswitch.port_of(station_haddr(idx)) == idx - 1);
+  // the neighbour solicitations are broadcast, the rest is unicast
+  REQUIRE(vswitch.stats().flooded > 0);
+  REQUIRE(vswitch.stats().forwarded > 0);
+  REQUIRE(vswitch.stats().dropped == 0);
+
+  // once the neighbours are resolved, nothing is flooded anymore
+  stations[1]->send("from 2", 3);
+  poll();
+  size_t flooded = vswitch.stats().flooded;
+  stations[1]->send("again", 3);
+  poll();
+  REQUIRE(stations[1]->replies == std::vector<std::string>{"from 2", "again"});
+  REQUIRE(vswitch.stats().flooded == flooded);
+}
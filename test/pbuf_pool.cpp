@@ -0,0 +1,132 @@
+#include <catch2/catch_test_macros.hpp>
+
+#include "jay/pbuf_pool.h"
+
+TEST_CASE("PBufPool recycles packets", "[pbuf]") {
+  jay::PBufPool pool(512, 2);
+
+  jay::PBufStruct *first_ptr;
+  {
+    jay::PBuf packet = pool.get(100);
+    first_ptr = packet.get();
+    REQUIRE(packet->size() == 100);
+    REQUIRE(packet->is_contiguous());
+    packet->unmask(jay::PBufStruct::HEADROOM);
+    REQUIRE(packet->size() == 100 + jay::PBufStruct::HEADROOM);
+  }
+  REQUIRE(pool.stats().misses == 1);
+  REQUIRE(pool.available() == 1);
+
+  {
+    jay::PBuf packet = pool.get(200);
+    REQUIRE(packet.get() == first_ptr);
+    REQUIRE(packet->size() == 200);
+    REQUIRE(!packet->local);
+  }
+  REQUIRE(pool.stats().hits == 1);
+
+  SECTION("oversized packets are not pooled") {
+    jay::PBuf packet = pool.get(1000);
+    REQUIRE(packet->size() == 1000);
+    REQUIRE(pool.stats().misses == 2);
+    REQUIRE(pool.available() == 1);
+  }
+
+  SECTION("escaped chunks are replaced") {
+    jay::Buf escaped;
+    {
+      jay::PBuf packet = pool.get(10);
+      escaped = packet->buf();
+    }
+    REQUIRE(pool.stats().escaped == 1);
+    jay::PBuf packet = pool.get(10);
+    std::fill(packet->begin(), packet->end(), 'X');
+    REQUIRE(*escaped.begin() != 'X');
+  }
+
+  SECTION("room policy is applied") {
+    pool.set_room({.headroom = 200});
+    jay::PBuf packet = pool.get(100);
+    REQUIRE(packet->size() == 100);
+    packet->unmask(200);
+    REQUIRE(packet->begin().contiguous().size() == 300);
+    REQUIRE(pool.stats().hits == 2);
+
+    jay::PBuf large = pool.get(400);
+    REQUIRE(pool.stats().misses == 2);
+    REQUIRE(large->size() == 400);
+    large->reserve_headers();
+    large->unmask(200);
+    REQUIRE(large->is_contiguous());
+  }
+
+  SECTION("wrapping a payload reserves headroom") {
+    jay::Buf payload(50);
+    jay::PBuf packet = pool.get(payload);
+    REQUIRE(packet->size() == 50);
+    packet->unmask(jay::PBufStruct::HEADROOM);
+    REQUIRE(packet->begin().contiguous().size() == jay::PBufStruct::HEADROOM);
+  }
+}
+
+TEST_CASE("PBufs sharing a payload get private headers", "[pbuf]") {
+  jay::PBufPool pool(512, 4);
+  jay::Buf payload(jay::PBufStruct::HEADROOM + 100);
+  payload.mask(jay::PBufStruct::HEADROOM);
+  REQUIRE(payload.has_room_before(8));
+
+  jay::PBuf first = pool.get(payload);
+  REQUIRE(!payload.has_room_before(8));
+  jay::PBuf second = pool.get(payload);
+  auto first_hdr = first->construct_tspt_hdr<jay::udp::UDPHeader>().value();
+  auto second_hdr = second->construct_tspt_hdr<jay::udp::UDPHeader>().value();
+  first_hdr.dst_port() = 1;
+  second_hdr.dst_port() = 2;
+  REQUIRE(first_hdr.dst_port() == 1);
+  REQUIRE(second_hdr.dst_port() == 2);
+  REQUIRE(&*first->begin() == &*second->begin());
+
+  SECTION("a copied packet gets new room") {
+    jay::PBuf copy(first->buf(), false);
+    REQUIRE(!copy->has_room_before(8));
+    auto copy_hdr = copy->construct_tspt_hdr<jay::udp::UDPHeader>().value();
+    copy_hdr.dst_port() = 3;
+    REQUIRE(first_hdr.dst_port() == 1);
+    REQUIRE(&*copy->begin() == &*first->begin());
+  }
+}
+
+TEST_CASE("PBufPool copies payloads with their checksum", "[pbuf]") {
+  jay::PBufPool pool(512, 2);
+  jay::Buf payload(101);
+  for (size_t i = 0; i < payload.size(); i++)
+    *(payload.begin() + i) = i * 7;
+
+  jay::PBuf packet = pool.copy(payload);
+  REQUIRE(packet->is_contiguous());
+  REQUIRE(std::ranges::equal(packet->buf(), payload));
+  REQUIRE(&*packet->begin() != &*payload.begin());
+  REQUIRE(packet->payload_csum_valid);
+
+  auto udp_hdr = packet->construct_tspt_hdr<jay::udp::UDPHeader>().value();
+  packet->unmask(udp_hdr.size());
+  udp_hdr.src_port() = 1234;
+  udp_hdr.length() = packet->size();
+  REQUIRE(packet->tspt_csum(udp_hdr.size(), 0x1234) ==
+          jay::ip::inet_csum(packet->buf(), 0x1234));
+}
+
+TEST_CASE("PBufPool copies empty payloads", "[pbuf]") {
+  jay::PBufPool pool(512, 2);
+  jay::PBuf packet = pool.copy(jay::Buf());
+  REQUIRE(packet->size() == 0);
+  REQUIRE(packet->payload_csum_valid);
+  REQUIRE(packet->payload_csum == 0);
+
+  auto udp_hdr = packet->construct_tspt_hdr<jay::udp::UDPHeader>().value();
+  packet->unmask(udp_hdr.size());
+  udp_hdr.src_port() = 1234;
+  udp_hdr.length() = packet->size();
+  REQUIRE(packet->tspt_csum(udp_hdr.size(), 0x1234) ==
+          jay::ip::inet_csum(packet->buf(), 0x1234));
+}
@@ -0,0 +1,227 @@
+#include <catch2/catch_test_macros.hpp>
+
+#include <cstdio>
+#include <filesystem>
+#include <stdexcept>
+#include <string>
+#include <unistd.h>
+#include <vector>
+
+#include "helpers.h"
+#include "jay/pcap.h"
+#include "jay/stack.h"
+
+using namespace jay::test;
+
+namespace {
+/// A frame to be written to a capture, with its timestamp in nanoseconds.
+struct CapturedFrame {
+  std::vector<uint8_t> data;
+  uint64_t ts = 0;
+};
+
+/// Return a path in the temporary directory named after `name`, unique to the
+/// test process so that concurrent runs don't share the files.
+std::string temp_path(const std::string &name) {
+  std::string unique_name = std::to_string(getpid()) + "_" + name;
+  return (std::filesystem::temp_directory_path() / unique_name).string();
+}
+
+void put_u16(std::vector<uint8_t> &file, uint16_t value) {
+  file.insert(file.end(), reinterpret_cast<uint8_t *>(&value),
+              reinterpret_cast<uint8_t *>(&value) + 2);
+}
+void put_u32(std::vector<uint8_t> &file, uint32_t value) {
+  file.insert(file.end(), reinterpret_cast<uint8_t *>(&value),
+              reinterpret_cast<uint8_t *>(&value) + 4);
+}
+
+void write_file(const std::string &path, const std::vector<uint8_t> &file) {
+  std::FILE *f = std::fopen(path.c_str(), "wb");
+  REQUIRE(f != nullptr);
+  std::fwrite(file.data(), 1, file.size(), f);
+  std::fclose(f);
+}
+
+/// Write a pcap capture with microsecond timestamps.
+void write_pcap(const std::string &path,
+                const std::vector<CapturedFrame> &frames) {
+  std::vector<uint8_t> file;
+  put_u32(file, 0xa1b2c3d4);
+  put_u16(file, 2);
+  put_u16(file, 4);
+  put_u32(file, 0);
+  put_u32(file, 0);
+  put_u32(file, 0xffff);
+  put_u32(file, 1);
+  for (const CapturedFrame &frame : frames) {
+    put_u32(file, uint32_t(frame.ts / 1000000000));
+    put_u32(file, uint32_t(frame.ts % 1000000000 / 1000));
+    put_u32(file, uint32_t(frame.data.size()));
+    put_u32(file, uint32_t(frame.data.size()));
+    file.insert(file.end(), frame.data.begin(), frame.data.end());
+  }
+  write_file(path, file);
+}
+
+/// Write a pcapng capture of a single Ethernet interface with the default
+/// microsecond timestamp resolution.
+void write_pcapng(const std::string &path,
+                  const std::vector<CapturedFrame> &frames) {
+  std::vector<uint8_t> file;
+  // section header block
+  put_u32(file, 0x0a0d0d0a);
+  put_u32(file, 28);
+  put_u32(file, 0x1a2b3c4d);
+  put_u16(file, 1);
+  put_u16(file, 0);
+  put_u32(file, 0xffffffff);
+  put_u32(file, 0xffffffff);
+  put_u32(file, 28);
+  // interface description block
+  put_u32(file, 1);
+  put_u32(file, 20);
+  put_u16(file, 1);
+  put_u16(file, 0);
+  put_u32(file, 0xffff);
+  put_u32(file, 20);
+  // enhanced packet blocks
+  for (const CapturedFrame &frame : frames) {
+    size_t padded = (frame.data.size() + 3) & ~size_t(3);
+    auto len = uint32_t(32 + padded);
+    uint64_t ts = frame.ts / 1000;
+    put_u32(file, 6);
+    put_u32(file, len);
+    put_u32(file, 0);
+    put_u32(file, uint32_t(ts >> 32));
+    put_u32(file, uint32_t(ts));
+    put_u32(file, uint32_t(frame.data.size()));
+    put_u32(file, uint32_t(frame.data.size()));
+    file.insert(file.end(), frame.data.begin(), frame.data.end());
+    file.resize(file.size() + padded - frame.data.size());
+    put_u32(file, len);
+  }
+  write_file(path, file);
+}
+
+std::shared_ptr<jay::PcapInterface> replay(jay::Stack &stack,
+                                           const std::string &path,
+                                           jay::PcapInterface::Options opts) {
+  auto iface = std::make_shared<jay::PcapInterface>(path, opts);
+  jay::test::attach(stack, iface);
+  return iface;
+}
+
+/// Return the number of records of a pcap file written by [PcapInterface].
+size_t count_records(const std::string &path) {
+  std::FILE *f = std::fopen(path.c_str(), "rb");
+  REQUIRE(f != nullptr);
+  std::fseek(f, 24, SEEK_SET);
+  size_t count = 0;
+  uint32_t rec_hdr[4];
+  while (std::fread(rec_hdr, sizeof(rec_hdr), 1, f) == 1) {
+    std::fseek(f, rec_hdr[2], SEEK_CUR);
+    count++;
+  }
+  std::fclose(f);
+  return count;
+}
+} // namespace
+
+TEST_CASE("Pcap interface replays a capture and records the replies",
+          "[pcap]") {
+  std::vector<CapturedFrame> frames{
+      {echo_request(1)}, {arp_reply()}, {echo_request(2)}};
+  std::string input_path;
+  SECTION("pcap") {
+    input_path = temp_path("jay_test_replay.pcap");
+    write_pcap(input_path, frames);
+  }
+  SECTION("pcapng") {
+    input_path = temp_path("jay_test_replay.pcapng");
+    write_pcapng(input_path, frames);
+  }
+  std::string output_path = temp_path("jay_test_output.pcap");
+
+  {
+    jay::Stack stack;
+    auto iface = replay(stack, input_path, {.output_path = output_path});
+    while (!iface->done())
+      stack.poll();
+
+    REQUIRE(iface->stats().rx_packets == 3);
+    REQUIRE(iface->stats().passes == 1);
+    // the ARP solicitation and two echo replies, at least
+    REQUIRE(iface->stats().tx_packets >= 3);
+    iface->flush();
+    REQUIRE(count_records(output_path) == iface->stats().tx_packets);
+  }
+  std::filesystem::remove(input_path);
+  std::filesystem::remove(output_path);
+}
+
+TEST_CASE("Pcap interface loops over the capture", "[pcap]") {
+  std::string path = temp_path("jay_test_loop.pcap");
+  write_pcap(path, {{arp_reply()}, {echo_request(1)}});
+
+  jay::Stack stack;
+  auto iface = replay(stack, path, {.loop = true});
+  while (iface->stats().passes < 3)
+    stack.poll();
+  REQUIRE_FALSE(iface->done());
+  REQUIRE(iface->stats().rx_packets >= 4);
+  // each pass is replayed unmodified, so each request is answered
+  REQUIRE(iface->stats().tx_packets >= iface->stats().rx_packets / 2);
+  std::filesystem::remove(path);
+}
+
+TEST_CASE("Pcap interface ends a poll with each pass", "[pcap]") {
+  std::string path = temp_path("jay_test_pass.pcap");
+  // as many frames as fill whole bursts, which must not keep the stack
+  // draining the interface
+  std::vector<CapturedFrame> frames;
+  for (uint16_t seq = 0; seq < 64; seq++)
+    frames.push_back({echo_request(seq)});
+  write_pcap(path, frames);
+
+  jay::Stack stack;
+  auto iface = replay(stack, path, {.loop = true});
+  stack.poll();
+  REQUIRE(iface->stats().passes == 1);
+  REQUIRE(iface->stats().rx_packets == 64);
+  stack.poll();
+  REQUIRE(iface->stats().passes == 2);
+  REQUIRE(iface->stats().rx_packets == 128);
+  std::filesystem::remove(path);
+}
+
+TEST_CASE("Pcap interface replays the recorded timing", "[pcap]") {
+  std::string path = temp_path("jay_test_timing.pcap");
+  write_pcap(path, {{arp_reply(), 1000000000}, {echo_request(1), 2000000000}});
+
+  jay::Stack stack;
+  SECTION("at recorded speed") {
+    auto iface = replay(stack, path, {.speed = 1});
+    stack.poll();
+    stack.poll();
+    REQUIRE(iface->stats().rx_packets == 1);
+    REQUIRE_FALSE(iface->done());
+  }
+  SECTION("sped up") {
+    auto iface = replay(stack, path, {.speed = 1000});
+    while (!iface->done())
+      stack.poll();
+    REQUIRE(iface->stats().rx_packets == 2);
+    REQUIRE(iface->stats().elapsed >= std::chrono::milliseconds(1));
+    REQUIRE(iface->stats().packets_per_sec() > 0);
+  }
+  std::filesystem::remove(path);
+}
+
+TEST_CASE("Pcap interface rejects other files", "[pcap]") {
+  std::string path = temp_path("jay_test_invalid.pcap");
+  write_file(path, std::vector<uint8_t>(64, 0x55));
+  REQUIRE_THROWS_AS(jay::PcapInterface(path), std::invalid_argument);
+  std::filesystem::remove(path);
+  REQUIRE_THROWS_AS(jay::PcapInterface(path), std::system_error);
+}
@@ -0,0 +1,126 @@
+#include <catch2/catch_test_macros.hpp>
+
+#include <algorithm>
+#include <deque>
+#include <vector>
+
+#include "helpers.h"
+#include "jay/stack.h"
+
+using namespace jay::test;
+
+namespace {
+/// An interface receiving and transmitting the packets in bursts.
+class BurstInterface : public jay::Interface {
+public:
+  void enqueue(jay::PBuf packet) override {
+    sent.push_back(std::move(packet));
+  }
+  void enqueue_burst(std::span<jay::PBuf> packets) override {
+    tx_bursts.push_back(packets.size());
+    for (jay::PBuf &packet : packets)
+      sent.push_back(std::move(packet));
+  }
+  size_t poll_rx_burst(jay::Stack &,
+                       std::span<jay::PBuf> packets) override {
+    size_t n_packets = 0;
+    while ((n_packets < packets.size()) && !received.empty()) {
+      packets[n_packets++] = std::move(received.front());
+      received.pop_front();
+    }
+    return n_packets;
+  }
+  void poll_tx(jay::Stack &) override { sent_before_poll_tx = sent.size(); }
+  jay::HWAddr addr() const noexcept override { return LOCAL_HADDR; }
+  uint16_t mtu() const noexcept override { return 1500; }
+
+  std::deque<jay::PBuf> received;
+  std::vector<jay::PBuf> sent;
+  std::vector<size_t> tx_bursts;
+  /// the packets handed over when [poll_tx] was last called
+  size_t sent_before_poll_tx = 0;
+};
+
+jay::PBuf frame(jay::Stack &stack, const std::vector<uint8_t> &data) {
+  jay::PBuf packet = stack.pool.get(data.size());
+  std::copy(data.begin(), data.end(), packet->begin());
+  return packet;
+}
+} // namespace
+
+TEST_CASE("Stack processes bursts and transmits the replies in bursts",
+          "[stack]") {
+  jay::Stack stack;
+  auto iface = std::make_shared<BurstInterface>();
+  attach(stack, iface);
+  iface->sent.clear();
+  iface->tx_bursts.clear();
+
+  // the replies to the first two requests wait for the ARP reply
+  iface->received.push_back(frame(stack, echo_request(1)));
+  iface->received.push_back(frame(stack, echo_request(2)));
+  iface->received.push_back(frame(stack, arp_reply()));
+  iface->received.push_back(frame(stack, echo_request(3)));
+  iface->received.push_back(frame(stack, {0x00}));
+  stack.poll();
+
+  REQUIRE(iface->received.empty());
+  // a single burst, starting with the ARP solicitation
+  REQUIRE(iface->tx_bursts.size() == 1);
+  REQUIRE(iface->tx_bursts[0] == iface->sent.size());
+  // ...handed over before the interface completes its transmissions
+  REQUIRE(iface->sent_before_poll_tx == iface->sent.size());
+  auto ether_type = [](const jay::PBuf &packet) {
+    return jay::EtherType((*(packet->begin() + 12) << 8) |
+                          *(packet->begin() + 13));
+  };
+  REQUIRE(ether_type(iface->sent[0]) == jay::EtherType::ARP);
+  std::erase_if(iface->sent, [&](const jay::PBuf &packet) {
+    return ether_type(packet) != jay::EtherType::IPV4;
+  });
+  std::vector<uint8_t> seqs;
+  for (const jay::PBuf &reply : iface->sent) {
+    REQUIRE(std::equal(REMOTE_HADDR.begin(), REMOTE_HADDR.end(),
+                       reply->begin()));
+    // ICMP echo reply, carrying the sequence number of the request
+    REQUIRE(*(reply->begin() + jay::EthHeader::SIZE + 20) == 0);
+    seqs.push_back(*(reply->begin() + jay::EthHeader::SIZE + 27));
+  }
+  std::ranges::sort(seqs);
+  REQUIRE(seqs == std::vector<uint8_t>{1, 2, 3});
+
+  SECTION("single packets are handed over as bursts of one") {
+    stack.input(iface.get(), frame(stack, echo_request(4)));
+    REQUIRE(iface->tx_bursts.size() == 2);
+    REQUIRE(iface->tx_bursts[1] == 1);
+  }
+}
+
+TEST_CASE("Stack loops datagrams to local addresses back without "
+          "transmitting them",
+          "[stack]") {
+  jay::Stack stack;
+  auto iface = std::make_shared<BurstInterface>();
+  attach(stack, iface);
+  iface->sent.clear();
+
+  jay::udp::UDPSocket server_sock = stack.ip.udp_sock();
+  jay::udp::UDPSocket client_sock = stack.ip.udp_sock();
+  std::vector<size_t> received;
+  server_sock.listen(std::nullopt, 7);
+  server_sock.on_data_fn = [&](jay::udp::UDPSocket &, const jay::Buf &buf,
+                               jay::ip::IPAddr, uint16_t port) {
+    REQUIRE(port == 1000);
+    received.push_back(buf.size());
+  };
+  client_sock.listen(std::nullopt, 1000);
+
+  // datagrams exceeding the MTU are delivered whole
+  for (size_t size : {16, 4000}) {
+    jay::Buf buf(size);
+    std::fill(buf.begin(), buf.end(), 0xab);
+    client_sock.send(buf, LOCAL_IADDR, 7);
+  }
+  REQUIRE(received == std::vector<size_t>{16, 4000});
+  REQUIRE(iface->sent.empty());
+}
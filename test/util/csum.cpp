@@ -0,0 +1,132 @@
+#include <catch2/catch_test_macros.hpp>
+
+#include <algorithm>
+#include <bit>
+#include <vector>
+
+#include "jay/ip/common.h"
+#include "jay/util/csum.h"
+
+namespace {
+/// Reference RFC 1071 checksum, summing the big-endian 16-bit words.
+uint16_t reference_csum(std::span<const uint8_t> data) {
+  uint64_t sum = 0;
+  for (size_t i = 0; i < data.size(); i += 2) {
+    uint16_t word = uint16_t(data[i]) << 8;
+    if (i + 1 < data.size())
+      word |= data[i + 1];
+    sum += word;
+  }
+  while (sum >> 16)
+    sum = (sum & 0xffff) + (sum >> 16);
+  uint16_t csum = ~static_cast<uint16_t>(sum);
+  if constexpr (std::endian::native == std::endian::little)
+    csum = static_cast<uint16_t>((csum << 8) | (csum >> 8));
+  return csum;
+}
+} // namespace
+
+TEST_CASE("Checksum kernels agree with the reference", "[csum]") {
+  std::vector<uint8_t> data(70000);
+  for (size_t i = 0; i < data.size(); i++)
+    data[i] = (i * 31 + 7) % 256;
+
+  const std::vector<uint8_t> rfc_example = {0x00, 0x01, 0xf2, 0x03,
+                                            0xf4, 0xf5, 0xf6, 0xf7};
+  REQUIRE(jay::ip::inet_csum(rfc_example) == reference_csum(rfc_example));
+  REQUIRE(reference_csum(rfc_example) ==
+          ((std::endian::native == std::endian::little) ? 0x0d22 : 0x220d));
+
+  for (auto impl : {jay::CsumImpl::SCALAR, jay::CsumImpl::SSE2,
+                    jay::CsumImpl::AVX2, jay::CsumImpl::AVX512}) {
+    if (!jay::csum_supported(impl))
+      continue;
+    for (size_t offset : {0, 1, 3}) {
+      for (size_t len : {0, 1, 2, 7, 20, 63, 64, 129, 1500, 65535, 65536,
+                         69990}) {
+        std::span<const uint8_t> span(data.data() + offset, len);
+        uint16_t csum = ~jay::csum_fold(jay::csum_partial(span, 0, impl));
+        INFO("impl=" << int(impl) << " offset=" << offset << " len=" << len);
+        REQUIRE(csum == reference_csum(span));
+      }
+    }
+  }
+}
+
+TEST_CASE("Buf checksum carries odd bytes across chunks", "[csum]") {
+  std::vector<uint8_t> data(3001);
+  for (size_t i = 0; i < data.size(); i++)
+    data[i] = (i * 13 + 5) % 256;
+
+  jay::Buf buf(20);
+  buf.mask(20);
+  size_t offset = 0;
+  for (size_t len : {1, 7, 1000, 3, 1480, 510}) {
+    jay::Buf frag(len);
+    std::copy_n(data.begin() + offset, len, frag.begin());
+    REQUIRE(buf.insert(frag, offset).has_value());
+    offset += len;
+  }
+  REQUIRE(buf.size() == data.size());
+  REQUIRE(buf.chunk_count() > 1);
+  REQUIRE(jay::ip::inet_csum(buf) == reference_csum(data));
+  REQUIRE(jay::ip::inet_csum(buf, 0x1234) == jay::ip::inet_csum(data, 0x1234));
+}
+
+TEST_CASE("Checksum is computed while copying", "[csum]") {
+  std::vector<uint8_t> data(70000);
+  for (size_t i = 0; i < data.size(); i++)
+    data[i] = (i * 29 + 11) % 256;
+
+  for (auto impl : {jay::CsumImpl::SCALAR, jay::CsumImpl::SSE2,
+                    jay::CsumImpl::AVX2, jay::CsumImpl::AVX512}) {
+    if (!jay::csum_supported(impl))
+      continue;
+    for (size_t offset : {0, 1}) {
+      for (size_t len : {0, 3, 20, 64, 127, 1500, 65537}) {
+        std::span<const uint8_t> span(data.data() + offset, len);
+        std::vector<uint8_t> copy(len + 1, 0xaa);
+        uint64_t sum = jay::csum_copy(span, copy.data(), 0, impl);
+        INFO("impl=" << int(impl) << " offset=" << offset << " len=" << len);
+        REQUIRE(uint16_t(~jay::csum_fold(sum)) == reference_csum(span));
+        REQUIRE(std::equal(span.begin(), span.end(), copy.begin()));
+        REQUIRE(copy[len] == 0xaa);
+      }
+    }
+  }
+
+  jay::Buf buf(20);
+  buf.mask(20);
+  size_t offset = 0;
+  for (size_t len : {3, 1000, 1, 1480}) {
+    jay::Buf frag(len);
+    std::copy_n(data.begin() + offset, len, frag.begin());
+    REQUIRE(buf.insert(frag, offset).has_value());
+    offset += len;
+  }
+  std::span<const uint8_t> expected(data.data(), offset);
+  uint64_t sum = 0;
+  jay::Buf contig = buf.as_contiguous(&sum);
+  REQUIRE(contig.is_contiguous());
+  REQUIRE(std::ranges::equal(contig, expected));
+  REQUIRE(uint16_t(~jay::csum_fold(sum)) == reference_csum(expected));
+  REQUIRE(contig.as_contiguous(&sum).is_contiguous());
+  REQUIRE(uint16_t(~jay::csum_fold(sum)) == reference_csum(expected));
+}
+
+TEST_CASE("Checksum is updated incrementally", "[csum]") {
+  std::vector<uint8_t> data(101);
+  for (size_t i = 0; i < data.size(); i++)
+    data[i] = (i * 17 + 3) % 256;
+  uint16_t csum = jay::ip::inet_csum(data);
+
+  for (size_t offset : {0, 1, 10, 97}) {
+    std::vector<uint8_t> old_bytes(data.begin() + offset,
+                                   data.begin() + offset + 4);
+    std::vector<uint8_t> new_bytes = {0xff, 0x00, 0x12, 0xab};
+    std::copy(new_bytes.begin(), new_bytes.end(), data.begin() + offset);
+    csum = jay::csum_replace(csum, old_bytes, new_bytes, offset & 1);
+    INFO("offset=" << offset);
+    REQUIRE(csum == jay::ip::inet_csum(data));
+  }
+}
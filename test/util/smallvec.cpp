@@ -16,3 +16,26 @@ TEST_CASE("smallvec", "[smallvec]") {
 
   REQUIRE_THAT(vec, Catch::Matchers::RangeEquals({1, 3, 5, 7, 9}));
 }
+
+TEST_CASE("smallvec migrates to a single heap buffer", "[smallvec]") {
+  jay::SmallVec<std::string, 2> vec {"a", "b"};
+  REQUIRE(vec.is_inline());
+  vec.emplace(vec.begin() + 1, "c");
+  REQUIRE_FALSE(vec.is_inline());
+  REQUIRE(vec.capacity() >= 3);
+  REQUIRE(&*vec.end() - &*vec.begin() == 3);
+  REQUIRE_THAT(vec, Catch::Matchers::RangeEquals(std::vector<std::string>{"a", "c", "b"}));
+
+  jay::SmallVec<std::string, 2> copy = vec;
+  jay::SmallVec<std::string, 2> moved = std::move(vec);
+  REQUIRE(vec.empty());
+  REQUIRE_THAT(moved, Catch::Matchers::RangeEquals(copy));
+
+  moved.erase(moved.begin(), moved.begin() + 2);
+  REQUIRE_THAT(moved, Catch::Matchers::RangeEquals(std::vector<std::string>{"b"}));
+  jay::SmallVec<std::string, 2> small;
+  small.emplace_back("d");
+  moved = std::move(small);
+  REQUIRE(moved.is_inline());
+  REQUIRE_THAT(moved, Catch::Matchers::RangeEquals(std::vector<std::string>{"d"}));
+}
@@ -0,0 +1,61 @@
+#include "jay/util/spsc_ring.h"
+#include <array>
+#include <catch2/catch_test_macros.hpp>
+#include <memory>
+#include <stdexcept>
+#include <thread>
+
+TEST_CASE("SPSC ring preserves order and bounds its size", "[spsc_ring]") {
+  jay::SpscRing<std::unique_ptr<int>> ring(4);
+  REQUIRE(ring.capacity() == 4);
+  REQUIRE(ring.empty());
+  REQUIRE_FALSE(ring.pop().has_value());
+
+  // several rounds, so that the indices wrap around the slots
+  int next_push = 0, next_pop = 0;
+  for (int round = 0; round < 3; round++) {
+    while (ring.size() < ring.capacity())
+      REQUIRE(ring.push(std::make_unique<int>(next_push++)));
+    auto rejected = std::make_unique<int>(-1);
+    REQUIRE_FALSE(ring.push(std::move(rejected)));
+    REQUIRE(rejected != nullptr);
+
+    auto value = ring.pop();
+    REQUIRE(value.has_value());
+    REQUIRE(**value == next_pop++);
+
+    std::array<std::unique_ptr<int>, 8> values;
+    size_t count = ring.pop_burst(values);
+    REQUIRE(count == 3);
+    for (size_t i = 0; i < count; i++)
+      REQUIRE(*values[i] == next_pop++);
+    REQUIRE(ring.empty());
+  }
+
+  REQUIRE_THROWS_AS(jay::SpscRing<int>(6), std::invalid_argument);
+}
+
+TEST_CASE("SPSC ring hands values over between threads", "[spsc_ring]") {
+  constexpr size_t COUNT = 100000;
+  jay::SpscRing<size_t> ring(64);
+  std::thread producer([&] {
+    for (size_t i = 0; i < COUNT; i++) {
+      while (!ring.push(size_t(i)))
+        std::this_thread::yield();
+    }
+  });
+
+  size_t expected = 0;
+  bool in_order = true;
+  std::array<size_t, 16> values;
+  while (expected < COUNT) {
+    size_t count = ring.pop_burst(values);
+    for (size_t i = 0; i < count; i++)
+      in_order &= values[i] == expected++;
+    if (!count)
+      std::this_thread::yield();
+  }
+  producer.join();
+  REQUIRE(in_order);
+  REQUIRE(ring.empty());
+}